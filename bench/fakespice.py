@@ -0,0 +1,209 @@
+#!/usr/bin/env python3
+#-------------------------------------------------------------------------
+#
+#  Copyright (c) 2021 Rajit Manohar
+#
+#  This program is free software; you can redistribute it and/or
+#  modify it under the terms of the GNU General Public License
+#  as published by the Free Software Foundation; either version 2
+#  of the License, or (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program; if not, write to the Free Software
+#  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+#  Boston, MA  02110-1301, USA.
+#
+#-------------------------------------------------------------------------
+#
+#
+# Stand-in circuit simulator for benchmarking xcell without Xyce or
+# hspice. It reads the .measure statements from a deck and writes
+# plausible results in the format of the simulator it is named after:
+#
+#   *Xyce*   <deck>.mt<k>, one file per .step / .data row, and an
+#            ASCII <deck>.raw when there is a .print tran format=raw
+#   other    <deck minus .spi>.mt0, one block per sweep row, each
+#            terminated by its "load = <value>" line
+#
+# Measurement values are deterministic functions of the measurement
+# name, load, and Monte Carlo sample so that repeated runs produce
+# identical libraries. FAKESPICE_DELAY (seconds) adds a fixed sleep per
+# deck to emulate simulation cost.
+#
+import os
+import re
+import sys
+import time
+import zlib
+
+UNITS = { "f" : 1e-15, "p" : 1e-12, "n" : 1e-9, "u" : 1e-6, "m" : 1e-3,
+          "k" : 1e3, "meg" : 1e6, "g" : 1e9 }
+
+def number (s):
+    m = re.match (r"^([-+]?[0-9.]+(?:e[-+]?[0-9]+)?)(meg|[fpnumkg])?", s.lower ())
+    if not m:
+        return None
+    v = float (m.group (1))
+    if m.group (2):
+        v *= UNITS[m.group (2)]
+    return v
+
+def jitter (name, sample):
+    # deterministic value in [0,1)
+    return (zlib.crc32 (("%s/%d" % (name, sample)).encode ()) & 0xffff) / 65536.0
+
+def read_deck (fname):
+    lines = []
+    with open (fname) as fp:
+        for l in fp:
+            l = l.rstrip ("\n")
+            if l.startswith ("+") and lines:
+                lines[-1] += " " + l[1:]
+            else:
+                lines.append (l)
+    return lines
+
+def parse_deck (lines):
+    deck = { "measures" : [], "rows" : None, "print" : None, "vdd" : 1.0,
+             "tend" : 1e-9 }
+    for l in lines:
+        toks = l.split ()
+        if not toks:
+            continue
+        key = toks[0].lower ()
+        if key == ".measure" and len (toks) > 2:
+            deck["measures"].append (toks[2])
+        elif key == ".step" and len (toks) > 3 and toks[2].upper () == "LIST":
+            deck["rows"] = [(number (t), 0) for t in toks[3:]]
+        elif key == ".data" and len (toks) > 2:
+            # .data name [load param] then rows of values
+            vals = [number (t) for t in toks[2:] if number (t) is not None]
+            ncol = len ([t for t in toks[2:] if number (t) is None])
+            if ncol < 1:
+                ncol = 2
+            deck["rows"] = [(vals[i], int (vals[i+1]) if ncol > 1 else 0)
+                            for i in range (0, len (vals) - ncol + 1, ncol)]
+        elif key == ".tran" and len (toks) > 2:
+            deck["tend"] = number (toks[2]) or deck["tend"]
+            up = [t.upper () for t in toks]
+            if "SWEEP" in up:
+                i = up.index ("SWEEP")
+                if i + 3 < len (toks) and up[i+2] == "POI":
+                    deck["rows"] = [(number (t), 0) for t in toks[i+4:]]
+        elif key == ".print":
+            deck["print"] = [t for t in toks[2:] if "(" in t]
+        elif key.startswith ("vv1") and len (toks) > 3:
+            v = number (toks[3])
+            if v:
+                deck["vdd"] = v
+    if deck["rows"] is None:
+        deck["rows"] = [(None, 0)]
+    return deck
+
+def measure (name, load, sample, vdd):
+    base = name.lower ()
+    j = jitter (name, sample)
+    cl = (load or 1e-15) * 1e15
+    idx = [int (x) for x in re.findall (r"_(\d+)", base)]
+    ns = idx[-1] if idx else 0
+    if base.startswith ("negdelay_"):
+        return -1
+    if base.startswith ("delay_") or base.startswith ("cq_"):
+        return 1e-12 * (12 + 2.5 * cl + 3 * ns) * (1 + 0.05 * j)
+    if base.startswith ("transit_") or base.startswith ("cqt"):
+        return 1e-12 * (8 + 4 * cl + 2 * ns) * (1 + 0.05 * j)
+    if base.startswith ("intpow_"):
+        return -1e-6 * (5 + 0.5 * cl) * (1 + 0.05 * j)
+    if base.startswith ("current_"):
+        return -1e-9 * (1 + j)
+    if base.startswith ("leak_"):
+        return 1e-9 * (1 + j) * vdd
+    if base.startswith ("cap_"):
+        return 1e-12 * (2 + j)
+    if base.startswith ("qend_") or base.startswith ("cqref_"):
+        return vdd
+    if base.startswith ("qref_") or base.startswith ("vchk_"):
+        return 0.0
+    return 1e-12 * (1 + j)
+
+def write_raw (fname, deck, vdd):
+    names = deck["print"]
+    npts = 200
+    with open (fname, "w") as fp:
+        for row, (load, sample) in enumerate (deck["rows"]):
+            fp.write ("Title: fakespice\n")
+            fp.write ("Date: %s\n" % time.ctime ())
+            fp.write ("Plotname: Transient Analysis\n")
+            fp.write ("Flags: real\n")
+            fp.write ("No. Variables: %d\n" % (len (names) + 1))
+            fp.write ("No. Points: %d\n" % npts)
+            fp.write ("Variables:\n\t0\ttime\ttime\n")
+            for i, n in enumerate (names):
+                fp.write ("\t%d\t%s\tvoltage\n" % (i+1, n.upper ()))
+            fp.write ("Values:\n")
+            for p in range (npts):
+                t = deck["tend"] * p / (npts - 1)
+                fp.write ("%d\t%.8e\n" % (p, t))
+                for i in range (len (names)):
+                    # staggered ramps between the rails
+                    ph = (p + 17 * i) % 50
+                    v = vdd * min (1.0, max (0.0, (ph - 20) / 10.0)) \
+                        if ph < 35 else vdd * max (0.0, (45 - ph) / 10.0)
+                    fp.write ("\t%.8e\n" % v)
+
+def main ():
+    if len (sys.argv) < 2:
+        sys.stderr.write ("Usage: %s <deck.spi>\n" % sys.argv[0])
+        return 1
+    spi = sys.argv[1]
+    xyce = "Xyce" in os.path.basename (sys.argv[0])
+    t0 = time.time ()
+    deck = parse_deck (read_deck (spi))
+    vdd = deck["vdd"]
+
+    if os.environ.get ("FAKESPICE_DELAY"):
+        time.sleep (float (os.environ["FAKESPICE_DELAY"]))
+
+    rows = deck["rows"]
+    if xyce:
+        for row, (load, sample) in enumerate (rows):
+            with open ("%s.mt%d" % (spi, row), "w") as fp:
+                for m in deck["measures"]:
+                    fp.write ("%s = %.6e\n" % (m, measure (m, load, sample, vdd)))
+        if deck["print"]:
+            write_raw (spi + ".raw", deck, vdd)
+    else:
+        base = spi[:-4] if spi.endswith (".spi") else spi
+        with open (base + ".mt0", "w") as fp:
+            fp.write ("$DATA1 SOURCE='FAKESPICE'\n.TITLE '%s'\n" % spi)
+            for row, (load, sample) in enumerate (rows):
+                for m in deck["measures"]:
+                    fp.write ("%s = %.6e\n" % (m, measure (m, load, sample, vdd)))
+                if load is not None:
+                    fp.write ("load = %.6e\n" % load)
+
+    # solver statistics in the simulator's own log format
+    npts = 100 * len (rows)
+    el = time.time () - t0
+    if xyce:
+        for r in rows:
+            print ("  Number Successful Steps Taken:\t\t100")
+            print ("  Number Failed Steps Attempted:\t\t2")
+            print ("  Number Jacobians Evaluated:\t\t\t250")
+            print ("  Number Linear Solves:\t\t\t\t300")
+        print ("***** Problem read in and set up time: %g seconds" % (el / 2))
+        print ("***** Total Elapsed Run Time: %g seconds" % el)
+    else:
+        print ("  transient %10.3f %9d %9d %9d rev= %9d" %
+               (el, npts, 3 * npts, 2 * npts, 2 * len (rows)))
+        print ("  readin     %10.3f" % (el / 2))
+        print ("  total cpu time %10.3f seconds" % el)
+    return 0
+
+if __name__ == "__main__":
+    sys.exit (main ())
@@ -0,0 +1,111 @@
+#!/usr/bin/env python3
+#-------------------------------------------------------------------------
+#
+#  Copyright (c) 2021 Rajit Manohar
+#
+#  This program is free software; you can redistribute it and/or
+#  modify it under the terms of the GNU General Public License
+#  as published by the Free Software Foundation; either version 2
+#  of the License, or (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program; if not, write to the Free Software
+#  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+#  Boston, MA  02110-1301, USA.
+#
+#-------------------------------------------------------------------------
+#
+# Generate a synthetic ACT cell library for benchmarking xcell.
+#
+#   gencells.py [-n cells] [-k max-inputs] [-m kinds] > bench.act
+#
+# kinds is a comma-separated list of nand, nor, aoi, celem, multi.
+# Cells cycle through the kinds and through 2 ... max-inputs inputs.
+#
+import argparse
+
+def nand (k):
+    dn = "&".join ("in[%d]" % i for i in range (k))
+    up = "|".join ("~in[%d]" % i for i in range (k))
+    return k, 1, [], ["%s -> out-" % dn, "%s -> out+" % up]
+
+def nor (k):
+    dn = "|".join ("in[%d]" % i for i in range (k))
+    up = "&".join ("~in[%d]" % i for i in range (k))
+    return k, 1, [], ["%s -> out-" % dn, "%s -> out+" % up]
+
+def aoi (k):
+    # AND pairs, ORed together: aoi21, aoi22, aoi221, ...
+    terms = []
+    i = 0
+    while i < k:
+        terms.append (list (range (i, min (i+2, k))))
+        i += 2
+    dn = "|".join ("(" + "&".join ("in[%d]" % j for j in t) + ")" for t in terms)
+    up = "&".join ("(" + "|".join ("~in[%d]" % j for j in t) + ")" for t in terms)
+    return k, 1, [], ["%s -> out-" % dn, "%s -> out+" % up]
+
+def celem (k):
+    # C-element: state-holding node with a keeper, and an output inverter
+    dn = "&".join ("in[%d]" % i for i in range (k))
+    up = "&".join ("~in[%d]" % i for i in range (k))
+    return k, 1, ["_x"], ["%s -> _x-" % dn, "%s -> _x+" % up,
+                          "_x => out-"]
+
+def multi (k):
+    # NAND and NOR of the same inputs
+    _, _, _, a = nand (k)
+    _, _, _, b = nor (k)
+    return k, 2, [], [r.replace ("out", "out[0]") for r in a] + \
+        [r.replace ("out", "out[1]") for r in b]
+
+KINDS = { "nand" : nand, "nor" : nor, "aoi" : aoi, "celem" : celem,
+          "multi" : multi }
+
+def main ():
+    ap = argparse.ArgumentParser ()
+    ap.add_argument ("-n", type=int, default=16, help="number of cells")
+    ap.add_argument ("-k", type=int, default=4, help="max inputs per cell")
+    ap.add_argument ("-m", default="nand,nor,aoi,celem,multi",
+                     help="cell kinds")
+    args = ap.parse_args ()
+
+    kinds = args.m.split (",")
+    for kind in kinds:
+        if kind not in KINDS:
+            raise SystemExit ("unknown cell kind `%s'" % kind)
+
+    print ("namespace bench {\n")
+    names = []
+    for c in range (args.n):
+        kind = kinds[c % len (kinds)]
+        k = 2 + (c // len (kinds)) % (args.k - 1)
+        nin, nout, internal, prs = KINDS[kind] (k)
+        name = "%s%d_%d" % (kind, k, c)
+        names.append (name)
+        out = "out[%d]" % nout if nout > 1 else "out"
+        print ("export defcell %s (bool? in[%d]; bool! %s)" % (name, nin, out))
+        print ("{")
+        for x in internal:
+            print ("  bool %s;" % x)
+        print ("  prs * {")
+        for r in prs:
+            print ("    %s" % r)
+        print ("  }")
+        print ("}\n")
+    print ("}\n")
+
+    print ("defproc characterize()")
+    print ("{")
+    for i, name in enumerate (names):
+        print ("  bench::%s g%d;" % (name, i+1))
+    print ("}\n")
+    print ("characterize c;")
+
+if __name__ == "__main__":
+    main ()
@@ -0,0 +1,63 @@
+#!/bin/sh
+#-------------------------------------------------------------------------
+#
+#  Copyright (c) 2021 Rajit Manohar
+#
+#  This program is free software; you can redistribute it and/or
+#  modify it under the terms of the GNU General Public License
+#  as published by the Free Software Foundation; either version 2
+#  of the License, or (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program; if not, write to the Free Software
+#  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+#  Boston, MA  02110-1301, USA.
+#
+#-------------------------------------------------------------------------
+#
+# Micro-benchmarks of the scenario generation and post-processing
+# kernels, for every cell kind with 2 ... MAXIN inputs. No simulator
+# is run.
+#
+#   micro.sh [baseline]           (default: bench/micro.base)
+#
+# The first run writes the baseline; later runs reuse its iteration
+# counts and exit with status 1 if a kernel is slower than
+# xcell.microbench.tol percent.
+#
+# Environment:
+#   XCELL       xcell binary (default: xcell in the PATH)
+#   KINDS       cell kinds passed to gencells.py
+#   MAXIN       max inputs per cell (default: 8)
+#
+set -e
+
+here=$(cd "$(dirname "$0")" && pwd)
+xcell=${XCELL:-xcell}
+kinds=${KINDS:-nand,nor,aoi,celem,multi}
+maxin=${MAXIN:-8}
+baseline=${1:-$here/micro.base}
+case $baseline in
+  /*) ;;
+  *) baseline=$(pwd)/$baseline ;;
+esac
+
+nkinds=$(echo "$kinds" | tr ',' '\n' | wc -l)
+ncells=$((nkinds * (maxin - 1)))
+
+w=$here/work/micro
+rm -rf "$w"
+mkdir -p "$w"
+cd "$w"
+
+cp "$here/../example/stdspice.spi" .
+python3 "$here/gencells.py" -n "$ncells" -k "$maxin" -m "$kinds" > micro.act
+sed -e "s|^#  string baseline.*|  string baseline \"$baseline\"|" \
+    "$here/../example/xcell.conf" > xcell.conf
+
+exec "$xcell" -cnf=xcell.conf micro.act micro
@@ -0,0 +1,101 @@
+#!/bin/sh
+#-------------------------------------------------------------------------
+#
+#  Copyright (c) 2021 Rajit Manohar
+#
+#  This program is free software; you can redistribute it and/or
+#  modify it under the terms of the GNU General Public License
+#  as published by the Free Software Foundation; either version 2
+#  of the License, or (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program; if not, write to the Free Software
+#  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+#  Boston, MA  02110-1301, USA.
+#
+#-------------------------------------------------------------------------
+#
+# End-to-end benchmark: characterize synthetic libraries of increasing
+# size with a stand-in simulator, and report cells/second and peak
+# memory for each.
+#
+#   run.sh [ncells ...]           (default: 8 32 128)
+#
+# Environment:
+#   XCELL       xcell binary (default: xcell in the PATH)
+#   SIM         Xyce or hspice output format (default: Xyce)
+#   KINDS       cell kinds passed to gencells.py
+#   MAXIN       max inputs per cell (default: 4)
+#   JOBS        xcell.jobs (default: 0)
+#   FAKESPICE_DELAY  per-deck sleep in seconds, see fakespice.py
+#
+# Results are left in bench/work/<ncells>/, including the xcell
+# profile (bench.json, bench.csv).
+#
+set -e
+
+here=$(cd "$(dirname "$0")" && pwd)
+xcell=${XCELL:-xcell}
+sim=${SIM:-Xyce}
+kinds=${KINDS:-nand,nor,aoi,celem,multi}
+maxin=${MAXIN:-4}
+jobs=${JOBS:-0}
+sizes=${*:-8 32 128}
+
+case $sim in
+  Xyce) fake=fakeXyce; fmt=0 ;;
+  hspice) fake=fakehspice; fmt=1 ;;
+  *) echo "$0: SIM must be Xyce or hspice" 1>&2; exit 1 ;;
+esac
+
+if [ -x /usr/bin/time ]; then
+  timer="/usr/bin/time -f %e:%M -o time.out"
+else
+  timer=""
+fi
+
+printf "%8s %10s %10s %12s\n" cells seconds cells/s maxrss-KB
+
+for n in $sizes; do
+  w=$here/work/$n
+  rm -rf "$w"
+  mkdir -p "$w"
+  cd "$w"
+
+  ln -s "$here/fakespice.py" $fake
+  cp "$here/../example/stdspice.spi" .
+  python3 "$here/gencells.py" -n "$n" -k "$maxin" -m "$kinds" > bench.act
+
+  # hspice .tr0 waveforms are not emulated, so logic is always taken
+  # from the production rules
+  sed -e "s|^string spice_binary.*|string spice_binary \"$w/$fake\"|" \
+      -e "s|^int spice_output_fmt.*|int spice_output_fmt $fmt|" \
+      -e "s|^int logic_from_prs.*|int logic_from_prs 1|" \
+      -e "s|^int logic_check.*|int logic_check 0|" \
+      -e "s|^#string profile.*|string profile \"bench\"|" \
+      -e "s|^int jobs.*|int jobs $jobs|" \
+      "$here/../example/xcell.conf" > xcell.conf
+
+  start=$(date +%s.%N)
+  if ! $timer "$xcell" -cnf=xcell.conf bench.act bench > xcell.log 2>&1; then
+    echo "$0: xcell failed for $n cells; see $w/xcell.log" 1>&2
+    exit 1
+  fi
+  end=$(date +%s.%N)
+
+  if [ -f time.out ]; then
+    secs=$(tail -1 time.out | cut -d: -f1)
+    rss=$(tail -1 time.out | cut -d: -f2)
+  else
+    secs=$(awk "BEGIN { print $end - $start }")
+    rss=-
+  fi
+  rate=$(awk "BEGIN { printf \"%.2f\", $n / ($secs + 0.001) }")
+  printf "%8d %10.2f %10s %12s\n" "$n" "$secs" "$rate" "$rss"
+  cd "$here"
+done
@@ -20,6 +20,7 @@
  **************************************************************************
  */
 #include <stdio.h>
+#include <stdarg.h>
 #include <string.h>
 #include <unistd.h>
 #include <math.h>
@@ -27,6 +28,10 @@
 #include <common/misc.h>
 #include <common/atrace.h>
 #include "liberty.h"
+#include "jobs.h"
+#include "prof.h"
+#include "microbench.h"
+#include "watchdog.h"
 
 static int is_xyce (void)
 {
@@ -41,6 +46,106 @@ static int is_hspice (void)
   return !is_xyce();
 }
 
+/*
+  Leakage scenarios are visited in Gray code order, so only one input
+  changes between two consecutive slots.
+*/
+static unsigned int gray_code (unsigned int i)
+{
+  return i ^ (i >> 1);
+}
+
+/* position of vector g in the Gray code sequence */
+static unsigned int gray_rank (unsigned int g)
+{
+  unsigned int i = g;
+  while (g >>= 1) {
+    i ^= g;
+  }
+  return i;
+}
+
+static int bit_count (unsigned int x)
+{
+  int n = 0;
+  while (x) {
+    x &= x - 1;
+    n++;
+  }
+  return n;
+}
+
+static int _uint_cmp (const void *a, const void *b)
+{
+  unsigned int x = *((const unsigned int *)a);
+  unsigned int y = *((const unsigned int *)b);
+  if (x < y) return -1;
+  if (x > y) return 1;
+  return 0;
+}
+
+/*
+  Pick n distinct vectors out of 2^nbits, used by sparse cells instead
+  of enumerating every vector. The all-zero and all-one vectors are
+  always included; the rest come from a fixed pseudo-random sequence so
+  that runs are reproducible.
+*/
+static void sample_vectors (int nbits, int n, unsigned int *vec)
+{
+  unsigned int mask = (1U << nbits) - 1;
+  unsigned int seed = 12345;
+  bitset_t *b;
+  int k;
+
+  Assert (n <= (1 << nbits), "Too many samples");
+  b = bitset_new (1 << nbits);
+  bitset_clear (b);
+
+  k = 0;
+  vec[k++] = 0;
+  bitset_set (b, 0);
+  if (k < n) {
+    vec[k++] = mask;
+    bitset_set (b, mask);
+  }
+  while (k < n) {
+    unsigned int v;
+    seed = seed*1103515245 + 12345;
+    v = (seed >> 8) & mask;
+    if (!bitset_tst (b, v)) {
+      bitset_set (b, v);
+      vec[k++] = v;
+    }
+  }
+  bitset_free (b);
+}
+
+/*
+  Pick n distinct integers out of 0 ... m-1, from the same fixed
+  pseudo-random sequence as sample_vectors().
+*/
+static void sample_indices (int m, int n, int *out)
+{
+  unsigned int seed = 12345;
+  int *perm;
+
+  Assert (n <= m, "Too many samples");
+  MALLOC (perm, int, m);
+  for (int i=0; i < m; i++) {
+    perm[i] = i;
+  }
+  for (int i=0; i < n; i++) {
+    int j, tmp;
+    seed = seed*1103515245 + 12345;
+    j = i + (seed >> 8) % (m - i);
+    tmp = perm[i];
+    perm[i] = perm[j];
+    perm[j] = tmp;
+    out[i] = perm[i];
+  }
+  FREE (perm);
+}
+
 static void unlink_files (const char *s, const char *ext[])
 {
   char buf[1024];
@@ -68,6 +173,9 @@ static void unlink_xyce (const char *s)
 static void unlink_generic (const char *s)
 {
   const char *ext[] = { "spi", "log", NULL };
+
+  /*-- solver statistics, before the log goes away --*/
+  simlog_scan (s);
   unlink_files (s, ext);
 
   if (is_xyce ()) {
@@ -86,6 +194,23 @@ static void unlink_generic_trace (const char *s)
   unlink_files (s, ext);
 }
 
+/*-- whatever a deck of nrows rows left behind when the watchdog
+  killed it; Xyce writes a measurement file per row --*/
+static void unlink_killed (const char *s, int nrows)
+{
+  char buf[1024];
+
+  unlink_generic_trace (s);
+  if (is_xyce ()) {
+    for (int i=1; i < nrows; i++) {
+      snprintf (buf, 1024, "%s.spi.mt%d", s, i);
+      unlink (buf);
+    }
+    snprintf (buf, 1024, "%s.spi.res", s);
+    unlink (buf);
+  }
+}
+
 static void print_number (FILE *fp, double x)
 {
   if (x > 1e3) {
@@ -130,6 +255,227 @@ static void print_window (FILE *fp, double start, double end, int val)
 }
 
 
+/*
+  Timeline planner for simulation decks. Each scenario is given a
+  time slot that is only as long as it needs to be, followed by the
+  settle margin. All times are in picoseconds.
+*/
+struct timeline {
+  double t;			// start of the next free slot
+  double margin;		// idle time after each slot
+};
+
+/*
+  hold: time for which all sources keep their initial value; this is
+  shorter when the deck has initial conditions for the circuit state
+*/
+static void timeline_init (struct timeline *tl, double hold)
+{
+  tl->margin = config_get_real ("xcell.settle_margin");
+  if (tl->margin < 0) {
+    warning ("settle_margin (%g) is negative; using 0", tl->margin);
+    tl->margin = 0;
+  }
+  tl->t = hold + tl->margin;
+}
+
+static double timeline_alloc (struct timeline *tl, double len)
+{
+  double start = tl->t;
+  tl->t += len + tl->margin;
+  return start;
+}
+
+static double timeline_end (struct timeline *tl)
+{
+  return tl->t;
+}
+
+
+/*
+  Simulator accuracy presets: xcell.preset.<name>.<param>
+
+    tstep  : transient time step (ps)
+    tmax   : maximum time step (ps); 0 = simulator default
+    reltol, abstol : tolerances; 0 = simulator default
+    method : integration method (trap, gear); "" = simulator default
+*/
+static double preset_real (const char *preset, const char *param)
+{
+  char buf[1024];
+  snprintf (buf, 1024, "xcell.preset.%s.%s", preset, param);
+  if (!config_exists (buf)) {
+    snprintf (buf, 1024, "xcell.preset.%s.tstep", preset);
+    if (!config_exists (buf)) {
+      fatal_error ("Unknown simulator preset `%s'", preset);
+    }
+    return 0;
+  }
+  return config_get_real (buf);
+}
+
+static const char *preset_string (const char *preset, const char *param)
+{
+  char buf[1024];
+  snprintf (buf, 1024, "xcell.preset.%s.%s", preset, param);
+  if (!config_exists (buf)) {
+    return "";
+  }
+  return config_get_string (buf);
+}
+
+static void print_sim_options (FILE *fp, const char *preset)
+{
+  double reltol = preset_real (preset, "reltol");
+  double abstol = preset_real (preset, "abstol");
+  double tmax = preset_real (preset, "tmax");
+  const char *method = preset_string (preset, "method");
+
+  if (reltol <= 0 && abstol <= 0 && !*method && (tmax <= 0 || is_xyce())) {
+    return;
+  }
+  fprintf (fp, "\n* simulator preset: %s\n", preset);
+  if (is_xyce()) {
+    fprintf (fp, ".options TIMEINT");
+  }
+  else {
+    fprintf (fp, ".options");
+  }
+  if (reltol > 0) {
+    fprintf (fp, " RELTOL=%g", reltol);
+  }
+  if (abstol > 0) {
+    fprintf (fp, " ABSTOL=%g", abstol);
+  }
+  if (*method) {
+    fprintf (fp, " METHOD=%s", method);
+  }
+  if (tmax > 0 && is_hspice()) {
+    fprintf (fp, " DELMAX=%gp", tmax);
+  }
+  fprintf (fp, "\n\n");
+}
+
+/*
+  .tran statement for a run of length tend (ps), without the newline
+  so that the caller can add sweeps.
+*/
+static void print_tran (FILE *fp, const char *preset, double tend)
+{
+  double tstep = preset_real (preset, "tstep");
+  double tmax = preset_real (preset, "tmax");
+
+  fprintf (fp, ".tran %gp ", tstep);
+  print_number (fp, 1e-12*tend);
+  if (tmax > 0 && is_xyce()) {
+    fprintf (fp, " 0 %gp", tmax);
+  }
+}
+
+
+/*
+  Monte Carlo sweep that replaces the load sweep: one row per (sample,
+  load) pair, for samples mcbase ... mcbase+nmc-1. Follows print_tran
+  on the same line.
+*/
+static void print_mc_sweep (FILE *fp, int nmc, int mcbase)
+{
+  int nsweep = config_get_table_size ("xcell.load");
+  double *load_table = config_get_table_real ("xcell.load");
+  const char *param = config_get_string ("xcell.mc.param");
+
+  if (is_xyce()) {
+    fprintf (fp, "\n\n.data mcsweep\n+ load %s\n", param);
+  }
+  else {
+    fprintf (fp, " SWEEP DATA=mcsweep\n\n.data mcsweep load %s\n", param);
+  }
+  for (int s=0; s < nmc; s++) {
+    for (int i=0; i < nsweep; i++) {
+      fprintf (fp, "%s%gf %d\n", is_xyce() ? "+ " : "", load_table[i],
+	       mcbase + s);
+    }
+  }
+  fprintf (fp, ".enddata\n");
+  if (is_xyce()) {
+    fprintf (fp, ".step data=mcsweep\n\n");
+  }
+  else {
+    fprintf (fp, "\n.options measform=2\n");
+  }
+}
+
+/*
+  Standard deviation from the Monte Carlo sums (see _read_dynamic);
+  which = 0 for delay, 1 for transition
+*/
+static double mc_sigma (double *mc, int which)
+{
+  double n = mc[0];
+  double s = mc[1 + 2*which];
+  double s2 = mc[2 + 2*which];
+  double var;
+
+  if (n < 2) {
+    return 0;
+  }
+  var = (s2 - s*s/n)/(n - 1);
+  return var > 0 ? sqrt (var) : 0;
+}
+
+/*
+  Pick at most m of the n points (t[], y[]) such that linear
+  interpolation between them is within tol of every point: start with
+  the end points, and keep adding the one that fits worst. Returns the
+  number of points picked; their indices are in sel[], in order.
+*/
+static int ccs_select (int n, double *t, double *y, int m, double tol,
+		       int *sel)
+{
+  char *used;
+  int k;
+
+  MALLOC (used, char, n);
+  for (int i=0; i < n; i++) {
+    used[i] = 0;
+  }
+  used[0] = 1;
+  used[n-1] = 1;
+  k = (n > 1) ? 2 : 1;
+
+  while (k < m) {
+    int worst = -1;
+    double werr = tol;
+    int lo = 0;
+    for (int hi=1; hi < n; hi++) {
+      if (!used[hi]) continue;
+      for (int i=lo+1; i < hi; i++) {
+	double f = y[lo] + (y[hi] - y[lo])*(t[i] - t[lo])/(t[hi] - t[lo]);
+	if (fabs (f - y[i]) > werr) {
+	  werr = fabs (f - y[i]);
+	  worst = i;
+	}
+      }
+      lo = hi;
+    }
+    if (worst == -1) {
+      break;
+    }
+    used[worst] = 1;
+    k++;
+  }
+
+  k = 0;
+  for (int i=0; i < n; i++) {
+    if (used[i]) {
+      sel[k++] = i;
+    }
+  }
+  FREE (used);
+  return k;
+}
+
+
 static struct Hashtable *parse_measurements (const char *s, const char *param = NULL, int skip = 0)
 {
   FILE *fp;
@@ -143,6 +489,7 @@ static struct Hashtable *parse_measurements (const char *s, const char *param =
     return NULL;
   }
 
+  prof_begin (NULL, "parse");
   H = hash_new (8);
 
   if (skip > 0 && param) {
@@ -174,6 +521,7 @@ static struct Hashtable *parse_measurements (const char *s, const char *param =
     }
     else if (param && (strcmp (s, param) == 0)) {
       fclose (fp);
+      prof_end ();
       return H;
     }
 
@@ -209,6 +557,7 @@ static struct Hashtable *parse_measurements (const char *s, const char *param =
     b->f = v;
   }
   fclose (fp);
+  prof_end ();
   
   return H;
 }
@@ -238,17 +587,26 @@ static const char *_cellinfo (Process *p)
 #define CNLFP  _l->_line(); fprintf
 
 
-Cell::Cell (Liberty *l, Process *p)
+void Cell::_init (Liberty *l)
 {
-  _p = p;
+  _p = NULL;
   _l = l;
   a = ActNamespace::Act();
   _lfp = l->_lfp;
+  nl = NULL;
+  np = NULL;
+  _db_name = NULL;
+  _db_cfg = NULL;
+  _pin_names = NULL;
+  _lib_pins = NULL;
+  _is_dataflow = 0;
   A_INIT (_sh_vars);
   _num_inputs = 0;
   _num_outputs = 0;
   _outvals = NULL;
+  _num_outvals = 0;
   leakage_power = NULL;
+  _leak_sampled = NULL;
   time_up = NULL;
   time_dn = NULL;
   fn_override = NULL;
@@ -257,8 +615,26 @@ Cell::Cell (Liberty *l, Process *p)
   _is_out = NULL;
   _is_external = 0;
   _ext_type = 0;
+  _sparse = 0;
   A_INIT (dyn);
+  _user_dyn = 0;
+  A_INIT (dscen);
+  A_INIT (seq);
+  _ccs_off = NULL;
+  _arc_tab = NULL;
+  _clock_pin = -1;
+  _seq_inv = NULL;
+  _fail_msg = NULL;
+  _fail_log = NULL;
+  _optional = NULL;
+  _opt_failed = 0;
+  _sim_limit = 0;
+}
 
+Cell::Cell (Liberty *l, Process *p)
+{
+  _init (l);
+  _p = p;
   
   ActPass *ap = a->pass_find ("prs2net");
   if (!ap) {
@@ -327,11 +703,26 @@ Cell::Cell (Liberty *l, Process *p)
     nl = NULL;
     return;
   }
-  if (_num_inputs > 8) {
-    warning ("High fan-in cell?");
+  if (_num_inputs > config_get_int ("xcell.max_inputs")) {
+    warning ("Cell %s: %d inputs; limit is xcell.max_inputs (%d)",
+	     nl->bN->p->getName(), _num_inputs,
+	     config_get_int ("xcell.max_inputs"));
     nl = NULL;
     return;
   }
+  if (!_is_dataflow &&
+      _num_inputs > config_get_int ("xcell.sparse.min_inputs")) {
+    if (_is_external) {
+      warning ("Cell %s: high fan-in external cells are not supported",
+	       nl->bN->p->getName());
+      nl = NULL;
+      return;
+    }
+    _sparse = 1;
+    if (verbose) {
+      printf (" [sparse: %d inputs]\n", _num_inputs);
+    }
+  }
   if (_num_outputs == 0) {
     warning ("Cell %s: no outputs?", nl->bN->p->getName());
     nl = NULL;
@@ -392,21 +783,97 @@ Cell::Cell (Liberty *l, Process *p)
     }
     Assert (A_LEN (_sh_vars) > 0, "What?!");
 
+    /* -- compile the guards once, with variables numbered by their
+       position in _sh_vars -- */
+    struct pHashtable *H = phash_new (4);
+    for (int i=0; i < A_LEN (_sh_vars); i++) {
+      phash_bucket_t *b = phash_add (H, _sh_vars[i]->id);
+      b->i = i;
+    }
+
     for (int i=0; i < _num_stateholding; i++) {
+      _stateholding[i].prog[0] =
+	logic_compile (_stateholding[i].n->v->e_dn, nl->bN->cur, H);
+      _stateholding[i].prog[1] =
+	logic_compile (_stateholding[i].n->v->e_up, nl->bN->cur, H);
       _stateholding[i].tt[0] = bitset_new (1 << A_LEN (_sh_vars));
       _stateholding[i].tt[1] = bitset_new (1 << A_LEN (_sh_vars));
-      bitset_clear (_stateholding[i].tt[0]);
-      bitset_clear (_stateholding[i].tt[1]);
-      _build_truth_table (_stateholding[i].n->v->e_up, _stateholding[i].tt[1]);
-      _build_truth_table (_stateholding[i].n->v->e_dn, _stateholding[i].tt[0]);
+      logic_truth_table (_stateholding[i].prog[0], A_LEN (_sh_vars),
+			 _stateholding[i].tt[0]);
+      logic_truth_table (_stateholding[i].prog[1], A_LEN (_sh_vars),
+			 _stateholding[i].tt[1]);
+      _stateholding[i].st[0] = NULL;
+      _stateholding[i].st[1] = NULL;
+    }
+    phash_free (H);
+  }
+}
+
+/*
+  Record a characterization failure; deck is the file prefix of the
+  deck involved, if any. Only the first failure is kept. Returns 0 so
+  that callers can return its value. Inside an optional pass, only
+  that pass is abandoned (see _opt_failed) and the cell keeps its
+  nominal results.
+*/
+int Cell::_fail (const char *deck, const char *fmt, ...)
+{
+  char buf[1024];
+  va_list ap;
+
+  if (_fail_msg) {
+    return 0;
+  }
+  va_start (ap, fmt);
+  vsnprintf (buf, 1024, fmt, ap);
+  va_end (ap);
+  if (_optional) {
+    if (!_opt_failed) {
+      warning ("%s: %s; %s skipped, keeping the nominal results",
+	       _cell_name(), buf, _optional);
     }
+    _opt_failed = 1;
+    return 0;
+  }
+  _fail_msg = Strdup (buf);
+  if (deck) {
+    snprintf (buf, 1024, "%s.log", deck);
+    _fail_log = Strdup (buf);
+  }
+  warning ("%s: %s", _cell_name(), _fail_msg);
+  return 0;
+}
+
+void Cell::emit_placeholder ()
+{
+  _l->cell_begin ();
+  _lfp = _l->_lfp;
+  _printHeader ();
+  CNLFP (_lfp, "dont_use : true;\n");
+  for (int i=0; i < _num_inputs + _num_outputs; i++) {
+    CNLFP (_lfp, "pin(");
+    fputs (_lib_pin (i), _lfp);
+    fprintf (_lfp, ") {\n");
+    _l->_tab();
+    CNLFP (_lfp, "direction : %s;\n", i < _num_inputs ? "input" : "output");
+    _l->_untab();
+    CNLFP (_lfp, "}\n");
   }
+  _printFooter ();
+  _l->cell_end ();
+  _lfp = _l->_lfp;
 }
 
+
 void Cell::_printHeader ()
 {
   CNLFP (_lfp, "cell(");
-  a->mfprintfproc (_lfp, _p);
+  if (_p) {
+    a->mfprintfproc (_lfp, _p);
+  }
+  else {
+    fprintf (_lfp, "%s", _db_name);
+  }
   fprintf (_lfp, ") {\n");
   _l->_tab();
 
@@ -487,116 +954,294 @@ void Cell::_collect_support (act_prs_expr_t *e)
   }
 }
 
-int Cell::_eval_expr (act_prs_expr_t *e, unsigned int v)
+/*
+  Three-valued evaluation of a production rule guard: 0, 1, or 2 (X).
+  H maps canonical connections to an index into val[].
+*/
+int Cell::_logic_eval_expr (act_prs_expr_t *e, struct pHashtable *H,
+			    int *val)
 {
-  act_connection *c;
+  phash_bucket_t *b;
+  int l, r;
+
   if (!e) return 0;
   switch (e->type) {
   case ACT_PRS_EXPR_AND:
-    if (_eval_expr (e->u.e.l, v) && _eval_expr (e->u.e.r, v)) {
-      return 1;
-    }
-    return 0;
+    l = _logic_eval_expr (e->u.e.l, H, val);
+    if (l == 0) return 0;
+    r = _logic_eval_expr (e->u.e.r, H, val);
+    if (r == 0) return 0;
+    if (l == 1 && r == 1) return 1;
+    return 2;
     break;
+
   case ACT_PRS_EXPR_OR:
-    if (_eval_expr (e->u.e.l, v) || _eval_expr (e->u.e.r, v)) {
-      return 1;
-    }
-    return 0;
+    l = _logic_eval_expr (e->u.e.l, H, val);
+    if (l == 1) return 1;
+    r = _logic_eval_expr (e->u.e.r, H, val);
+    if (r == 1) return 1;
+    if (l == 0 && r == 0) return 0;
+    return 2;
     break;
 
   case ACT_PRS_EXPR_NOT:
-    return 1 - _eval_expr (e->u.e.l, v);
+    l = _logic_eval_expr (e->u.e.l, H, val);
+    if (l == 2) return 2;
+    return 1 - l;
     break;
 
   case ACT_PRS_EXPR_LABEL:
-    warning ("labels within state-holding gate...");
-    return 0;
+    warning ("labels within gate...");
+    return 2;
     break;
 
   case ACT_PRS_EXPR_TRUE:
     return 1;
     break;
-    
+
   case ACT_PRS_EXPR_FALSE:
     return 0;
     break;
 
   case ACT_PRS_EXPR_VAR:
-    c = e->u.v.id->Canonical (nl->bN->cur);
-    for (int i=0; i < A_LEN (_sh_vars); i++) {
-      if (_sh_vars[i]->id == c) {
-	return ((v >> i) & 1);
-      }
+    b = phash_lookup (H, e->u.v.id->Canonical (nl->bN->cur));
+    if (!b) {
+      return 2;
     }
-    fatal_error ("Didn't find input variable?!");
-    return 0;
+    return val[b->i];
     break;
-    
+
   default:
     fatal_error ("Unexpected type %d", e->type);
-    return 0;
+    return 2;
     break;
   }
 }
 
-void Cell::_build_truth_table (act_prs_expr_t *e, bitset_t *b)
+
+/*------------------------------------------------------------------------
+ *
+ *  Compute the truth tables for the outputs and the internal
+ *  state-holding nodes (_outvals) directly from the production rules
+ *  instead of from a simulation of every input vector.
+ *
+ *  Vectors are visited in Gray code order, and a node keeps its value
+ *  when neither its pull-up nor its pull-down is on. This is the same
+ *  order used by the leakage simulation, so state-holding nodes end up
+ *  with the same values for vectors where they are not driven.
+ *
+ *------------------------------------------------------------------------
+ */
+void Cell::_logic_outvals ()
 {
-  for (unsigned int i=0; i < (1 << A_LEN (_sh_vars)); i++) {
-    if (_eval_expr (e, i)) {
-      bitset_set (b, i);
-    }
-    else {
-      bitset_clr (b, i);
+  struct pHashtable *H;
+  phash_bucket_t *b;
+  A_DECL (node_t *, gates);
+  int nval;
+  int *val;
+  int *outidx;
+  int nout;
+
+  A_INIT (gates);
+  H = phash_new (8);
+
+  /*-- inputs first, then gates --*/
+  nval = 0;
+  for (int i=0; i < _num_inputs; i++) {
+    b = phash_add (H, nl->bN->ports[_get_input_pin (i)].c);
+    b->i = nval++;
+  }
+  for (node_t *n = nl->hd; n; n = n->next) {
+    if (!n->v || (!n->v->e_up && !n->v->e_dn)) continue;
+    if (phash_lookup (H, n->v->v->id)) continue;
+    b = phash_add (H, n->v->v->id);
+    b->i = nval++;
+    A_NEW (gates, node_t *);
+    A_NEXT (gates) = n;
+    A_INC (gates);
+  }
+
+  /*-- outputs, followed by internal state-holding nodes --*/
+  nout = _num_outputs;
+  for (int i=0; i < A_LEN (_sh_vars); i++) {
+    if (_sh_vars[i]->isport) continue;
+    nout++;
+  }
+  MALLOC (outidx, int, nout);
+  for (int i=0; i < _num_outputs; i++) {
+    b = phash_lookup (H, nl->bN->ports[_get_output_pin (i)].c);
+    outidx[i] = b ? b->i : -1;
+    if (!b) {
+      warning ("%s: output #%d is not driven by any gate", _p->getName(), i);
     }
   }
-}
+  nout = _num_outputs;
+  for (int i=0; i < A_LEN (_sh_vars); i++) {
+    if (_sh_vars[i]->isport) continue;
+    b = phash_lookup (H, _sh_vars[i]->id);
+    outidx[nout++] = b ? b->i : -1;
+  }
 
+  _free_outvals ();
+  MALLOC (_outvals, bitset_t *, nout);
+  _num_outvals = nout;
+  for (int i=0; i < nout; i++) {
+    _outvals[i] = bitset_new (1 << _num_inputs);
+    bitset_clear (_outvals[i]);
+  }
 
-Cell::~Cell()
-{
-  if (_outvals) {
-    for (int i=0; i < _num_outputs; i++) {
-      bitset_free (_outvals[i]);
+  MALLOC (val, int, nval);
+  for (int i=0; i < nval; i++) {
+    val[i] = 2;
+  }
+
+  for (int s=0; s < (1 << _num_inputs); s++) {
+    unsigned int v = gray_code (s);
+    int changed, iter;
+
+    for (int i=0; i < _num_inputs; i++) {
+      val[i] = (v >> i) & 1;
     }
 
-    int x = _num_outputs;
-  
-    for (int i=0; i < A_LEN (_sh_vars); i++) {
-      if (_sh_vars[i]->isport) continue;
-      bitset_free (_outvals[x]);
-      x++;
+    /*-- evaluate gates to a fixpoint --*/
+    iter = 0;
+    do {
+      changed = 0;
+      for (int g=0; g < A_LEN (gates); g++) {
+	int up = _logic_eval_expr (gates[g]->v->e_up, H, val);
+	int dn = _logic_eval_expr (gates[g]->v->e_dn, H, val);
+	int old = val[_num_inputs + g];
+	int nv;
+
+	if (up == 1 && dn == 0) {
+	  nv = 1;
+	}
+	else if (dn == 1 && up == 0) {
+	  nv = 0;
+	}
+	else if (up == 0 && dn == 0) {
+	  nv = old;
+	}
+	else if (up == 2 && dn == 0) {
+	  nv = (old == 1) ? 1 : 2;
+	}
+	else if (dn == 2 && up == 0) {
+	  nv = (old == 0) ? 0 : 2;
+	}
+	else {
+	  nv = 2;
+	}
+	if (nv != old) {
+	  val[_num_inputs + g] = nv;
+	  changed = 1;
+	}
+      }
+      iter++;
+    } while (changed && iter <= A_LEN (gates) + 1);
+
+    if (changed) {
+      warning ("%s: production rules oscillate for input vector %d",
+	       _p->getName(), v);
     }
-    FREE (_outvals);
-  }
-  
-  if (_num_stateholding > 0) {
-    for (int i=0; i < _num_stateholding; i++) {
-      bitset_free (_stateholding[i].tt[0]);
-      bitset_free (_stateholding[i].tt[1]);
-      if (_stateholding[i].st[0]) {
-	bitset_free (_stateholding[i].st[0]);
+
+    for (int j=0; j < nout; j++) {
+      if (outidx[j] == -1) continue;
+      if (val[outidx[j]] == 1) {
+	bitset_set (_outvals[j], v);
       }
-      if (_stateholding[i].st[1]) {
-	bitset_free (_stateholding[i].st[1]);
+      else if (val[outidx[j]] == 2 && verbose) {
+	warning ("%s: out[%d]: X for input vector %d", _p->getName(), j, v);
       }
     }
-    FREE (_stateholding);
-    _stateholding = NULL;
   }
-  A_FREE (_sh_vars);
 
-  if (_is_out) {
-    FREE (_is_out);
-  }
+  FREE (val);
+  FREE (outidx);
+  A_FREE (gates);
+  phash_free (H);
+}
 
-  for (int i=0; i < A_LEN (dyn); i++) {
-    FREE (dyn[i].delay);
-    FREE (dyn[i].transit);
-    FREE (dyn[i].intpow);
-  }  
 
-  A_FREE (dyn);
+void Cell::_free_outvals ()
+{
+  if (!_outvals) {
+    return;
+  }
+  for (int i=0; i < _num_outvals; i++) {
+    bitset_free (_outvals[i]);
+  }
+  FREE (_outvals);
+  _outvals = NULL;
+  _num_outvals = 0;
+}
+
+
+Cell::~Cell()
+{
+  _free_outvals ();
+  
+  if (_num_stateholding > 0) {
+    for (int i=0; i < _num_stateholding; i++) {
+      for (int k=0; k < 2; k++) {
+	if (_stateholding[i].tt[k]) {
+	  bitset_free (_stateholding[i].tt[k]);
+	}
+	if (_stateholding[i].prog[k]) {
+	  logic_free (_stateholding[i].prog[k]);
+	}
+      }
+      if (_stateholding[i].st[0]) {
+	bitset_free (_stateholding[i].st[0]);
+      }
+      if (_stateholding[i].st[1]) {
+	bitset_free (_stateholding[i].st[1]);
+      }
+    }
+    FREE (_stateholding);
+    _stateholding = NULL;
+  }
+  A_FREE (_sh_vars);
+
+  if (_is_out) {
+    FREE (_is_out);
+  }
+
+  if (_arc_tab) {
+    FREE (_arc_tab);
+  }
+  for (int i=0; i < A_LEN (dyn); i++) {
+    if (dyn[i].mc) {
+      FREE (dyn[i].mc);
+    }
+    if (dyn[i].ccs) {
+      for (int j=0; j < config_get_table_size ("xcell.input_trans")*
+	     config_get_table_size ("xcell.load"); j++) {
+	if (dyn[i].ccs[j].n > 0) {
+	  FREE (dyn[i].ccs[j].t);
+	  FREE (dyn[i].ccs[j].i);
+	}
+      }
+      FREE (dyn[i].ccs);
+    }
+  }  
+
+  A_FREE (dyn);
+  A_FREE (dscen);
+
+  for (int i=0; i < A_LEN (seq); i++) {
+    FREE (seq[i].val);
+    if (seq[i].transit) {
+      FREE (seq[i].transit);
+    }
+  }
+  A_FREE (seq);
+  if (_seq_inv) {
+    FREE (_seq_inv);
+  }
+
+  if (_leak_sampled) {
+    bitset_free (_leak_sampled);
+  }
 
   if (time_up) {
     FREE (time_up);
@@ -604,6 +1249,37 @@ Cell::~Cell()
   if (time_dn) {
     FREE (time_dn);
   }
+
+  if (_fail_msg) {
+    FREE (_fail_msg);
+  }
+  if (_fail_log) {
+    FREE (_fail_log);
+  }
+
+  if (_lib_pins) {
+    for (int i=0; i < _num_inputs + _num_outputs; i++) {
+      FREE (_lib_pins[i]);
+    }
+    FREE (_lib_pins);
+  }
+
+  if (_db_name) {
+    FREE (_db_name);
+    FREE (_db_cfg);
+    for (int i=0; i < _num_inputs + _num_outputs; i++) {
+      FREE (_pin_names[i]);
+    }
+    FREE (_pin_names);
+    if (fn_override) {
+      for (int i=0; i < _num_outputs; i++) {
+	if (fn_override[i]) {
+	  FREE (fn_override[i]);
+	}
+      }
+      FREE (fn_override);
+    }
+  }
 }
 
 int Cell::_run_leakage ()
@@ -621,6 +1297,14 @@ int Cell::_run_leakage ()
 
   A_INIT (outname);
 
+  /* -- truth tables either come from the PRS, or from the simulated
+     waveforms of every input vector; external cells have no PRS -- */
+  int logic_prs = (_sparse || config_get_int ("xcell.logic_from_prs")) &&
+    !_is_external;
+  if (logic_prs) {
+    _logic_outvals ();
+  }
+
   snprintf (file, 1024, "_splk_");
   a->msnprintfproc (file + 6, 1018, _p);
 
@@ -628,7 +1312,7 @@ int Cell::_run_leakage ()
 
   sfp = fopen (buf, "w");
   if (!sfp) {
-    fatal_error ("Could not open `%s' for writing", buf);
+    return _fail (NULL, "Could not open `%s' for writing", buf);
   }
 
   /* -- std header that instantiates the module -- */
@@ -638,66 +1322,103 @@ int Cell::_run_leakage ()
     unlink (buf);
     return 0;
   }
+  print_sim_options (sfp, config_get_string ("xcell.accuracy"));
 
-  /* -- generate all possible static input scenarios -- */
-  _print_all_input_cases (sfp, "p");
-  fprintf (sfp, "\n");
-
-  double period = config_get_real ("xcell.period");
   double vdd = config_get_real ("xcell.Vdd");
-  
-  /* -- measurement of current -- */
-  int tm = 1;
   double lk_window = config_get_real ("xcell.leak_window");
-  if (period / (2 * lk_window) < 2) {
-    fatal_error ("leak_window parameter (%g) is too large for period (%g)\n",
-		 lk_window, period);
+  double lk_settle = config_get_real ("xcell.leak_settle");
+
+  /* -- input vectors to simulate, in simulation order -- */
+  unsigned int *vec;
+  int nvec = _leakage_vectors (&vec);
+
+  /* -- plan the time slots: slot s holds input vector vec[s].
+     Each slot starts with a settling period sized by the number of
+     inputs that changed (one for Gray code order), but no shorter
+     than the settle margin, followed by leak_window used for the
+     average leakage current. The settling period replaces the margin
+     between slots -- */
+  struct timeline tl;
+  double *slot;
+  double *avg_st;
+  double margin;
+
+  timeline_init (&tl, _print_initial_state (sfp, vec[0]) ?
+		 config_get_real ("xcell.ic_hold") : 1000);
+  margin = tl.margin;
+  tl.margin = 0;
+  MALLOC (slot, double, nvec + 1);
+  MALLOC (avg_st, double, nvec);
+  for (int i=0; i < nvec; i++) {
+    int nflip;
+    double settle;
+
+    nflip = bit_count (vec[i] ^ (i > 0 ? vec[i-1] : 0));
+    settle = (nflip > 0 ? nflip : 1)*lk_settle;
+    if (settle > lk_window) {
+      settle = lk_window;
+    }
+    if (settle < margin) {
+      settle = margin;
+    }
+    slot[i] = timeline_alloc (&tl, settle + lk_window);
+    avg_st[i] = slot[i] + settle;
   }
-  for (int i=0; i < (1 << _num_inputs); i++) {
-    fprintf (sfp, ".measure tran current_%d avg i(Vv1) from ", i);
-    print_number (sfp, tm*period*1e-12);
+  slot[nvec] = timeline_end (&tl);
+
+  /* -- generate all the static input scenarios -- */
+  _print_all_input_cases (sfp, "p", nvec, vec, slot);
+  fprintf (sfp, "\n");
+  
+  /* -- measurement of current; measurements are named by input
+     vector, not slot -- */
+  for (int i=0; i < nvec; i++) {
+    unsigned int v = vec[i];
+    fprintf (sfp, ".measure tran current_%d avg i(Vv1) from ", v);
+    print_number (sfp, avg_st[i]*1e-12);
     fprintf (sfp, " to ");
-    print_number (sfp, ((tm+1)*period - lk_window)*1e-12);
+    print_number (sfp, (avg_st[i] + lk_window)*1e-12);
     fprintf (sfp, "\n");
-    fprintf (sfp, ".measure tran leak_%d PARAM='-current_%d*%g'\n", i, i,
+    fprintf (sfp, ".measure tran leak_%d PARAM='-current_%d*%g'\n", v, v,
 	     vdd);
-    tm++;
   }
 
-  fprintf (sfp, ".tran 0.1p ");
-  print_number (sfp, tm*period*1e-12);
+  print_tran (sfp, config_get_string ("xcell.accuracy"), timeline_end (&tl));
   fprintf (sfp, "\n");
 
-  if (is_hspice()) {
-    fprintf (sfp, ".options post post_version=9601\n");
-    fprintf (sfp, ".options measform=2\n");
-  }
-  
-  fprintf (sfp, ".print tran");
-  if (is_xyce()) {
-    fprintf (sfp, " format=raw");
-  }
-  
-  /* print voltages */
-  char bufout[1024];
-
-  int num_outputs;
-  for (int i=0; i < A_LEN (nl->bN->ports); i++) {
-    if (nl->bN->ports[i].omit) continue;
-    if (nl->bN->ports[i].input) continue;
-
+  /* -- outputs, followed by the internal nodes of state-holding
+     gates: the spice voltage name, and the name in the trace -- */
+  A_DECL (char *, vname);
+  A_INIT (vname);
+  for (int i=0; i < A_LEN (nl->bN->ports) + A_LEN (_sh_vars); i++) {
+    act_connection *c;
+    char bufout[1024];
+    char nbuf[1024];
     ActId *tmp;
-    char buf[1024];
-    tmp = nl->bN->ports[i].c->toid();
-    tmp->sPrint (buf, 1024);
+
+    if (i < A_LEN (nl->bN->ports)) {
+      if (nl->bN->ports[i].omit) continue;
+      if (nl->bN->ports[i].input) continue;
+      c = nl->bN->ports[i].c;
+    }
+    else {
+      if (_sh_vars[i - A_LEN (nl->bN->ports)]->isport) continue;
+      c = _sh_vars[i - A_LEN (nl->bN->ports)]->id;
+    }
+    tmp = c->toid();
+    tmp->sPrint (nbuf, 1024);
     delete tmp;
-    fprintf (sfp, " V(xtst%s", config_get_string ("net.spice_path_sep"));
-    a->mfprintf (sfp, "%s", buf);
-    fprintf (sfp, ") ");
+
+    snprintf (bufout, 1024, "V(xtst%s", config_get_string ("net.spice_path_sep"));
+    a->msnprintf (bufout + strlen (bufout), 1024 - strlen (bufout),
+		  "%s)", nbuf);
+    A_NEWM (vname, char *);
+    A_NEXT (vname) = Strdup (bufout);
+    A_INC (vname);
 
     snprintf (bufout, 1024, "xtst.");
     a->msnprintf (bufout + strlen (bufout), 1024 - strlen (bufout),
-		  "%s", buf);
+		  "%s", nbuf);
     for (int i=0; bufout[i]; i++) {
       bufout[i] = tolower(bufout[i]);
     }
@@ -705,38 +1426,54 @@ int Cell::_run_leakage ()
     A_NEXT (outname) = Strdup (bufout);
     A_INC (outname);
   }
-  num_outputs = A_LEN (outname);
-  Assert (_num_outputs == num_outputs, "What?");
 
-  /*-- we also need internal nodes for stateholding gates --*/
-  for (int i=0; i < A_LEN (_sh_vars); i++) {
-    if (_sh_vars[i]->isport) continue;
+  /* -- optional spot check of the PRS truth tables: sample the node
+     voltages at the end of a few leakage slots -- */
+  int nchk = 0;
+  if (logic_prs) {
+    nchk = config_get_int ("xcell.logic_check");
+    if (nchk > nvec) {
+      nchk = nvec;
+    }
+    for (int k=0; k < nchk; k++) {
+      int s = (k*nvec)/nchk;
+      for (int j=0; j < A_LEN (vname); j++) {
+	fprintf (sfp, ".measure tran vchk_%d_%d find %s at=", s, j, vname[j]);
+	print_number (sfp, (avg_st[s] + lk_window)*1e-12);
+	fprintf (sfp, "\n");
+      }
+    }
+    fprintf (sfp, "\n");
+  }
 
-    ActId *tmp;
-    char buf[1024];
-    tmp = _sh_vars[i]->id->toid();
-    tmp->sPrint (buf, 1024);
-    delete tmp;
-    fprintf (sfp, " V(xtst%s", config_get_string ("net.spice_path_sep"));
-    a->mfprintf (sfp, "%s", buf);
-    fprintf (sfp, ") ");
+  if (is_hspice()) {
+    if (!logic_prs) {
+      fprintf (sfp, ".options post post_version=9601\n");
+    }
+    fprintf (sfp, ".options measform=2\n");
+  }
 
-    snprintf (bufout, 1024, "xtst.");
-    a->msnprintf (bufout + strlen (bufout), 1024 - strlen (bufout),
-		  "%s", buf);
-    for (int i=0; bufout[i]; i++) {
-      bufout[i] = tolower(bufout[i]);
+  if (!logic_prs) {
+    fprintf (sfp, ".print tran");
+    if (is_xyce()) {
+      fprintf (sfp, " format=raw");
     }
-    A_NEWM (outname, char *);
-    A_NEXT (outname) = Strdup (bufout);
-    A_INC (outname);
+    for (int i=0; i < A_LEN (vname); i++) {
+      fprintf (sfp, " %s ", vname[i]);
+    }
+    fprintf (sfp, "\n");
   }
-  
-  fprintf (sfp, "\n");
+  for (int i=0; i < A_LEN (vname); i++) {
+    FREE (vname[i]);
+  }
+  A_FREE (vname);
 	 
   fprintf (sfp, ".end\n");
 
   fclose (sfp);
+  snprintf (buf, 1024, "%s.spi", file);
+  prof_deck (buf, timeline_end (&tl), 0);
+  double limit = wd_limit (buf, timeline_end (&tl), 1);
   
   /* -- run the spice simulation -- */
   
@@ -744,10 +1481,152 @@ int Cell::_run_leakage ()
 	    config_get_string ("xcell.spice_binary"),
 	    file, file);
 
-  system (buf);
+  if (prof_system ("sim", buf, limit) == JOBS_TIMEOUT) {
+    snprintf (buf, 1024, "%s.spi", file);
+    wd_timeout (buf, limit, "cell failed");
+    for (int i=0; i < A_LEN (outname); i++) {
+      FREE (outname[i]);
+    }
+    A_FREE (outname);
+    FREE (slot);
+    FREE (avg_st);
+    FREE (vec);
+    return _fail (file, "Leakage simulation timed out");
+  }
 
   /* -- extract results from spice run -- */
 
+  /* 
+     Step 1: truth tables
+  */
+  if (!logic_prs) {
+    for (int i=0; i < nvec; i++) {
+      /* sample at the end of the averaging window */
+      avg_st[i] += lk_window;
+    }
+    int ok = _read_leakage_trace (file, outname, A_LEN (outname),
+				  nvec, vec, avg_st);
+    if (!ok) {
+      for (int i=0; i < A_LEN (outname); i++) {
+	FREE (outname[i]);
+      }
+      A_FREE (outname);
+      A_FREE (_sh_vars);
+      FREE (slot);
+      FREE (avg_st);
+      FREE (vec);
+      return 0;
+    }
+  }
+  for (int i=0; i < A_LEN (outname); i++) {
+    FREE (outname[i]);
+  }
+  A_FREE (outname);
+  FREE (slot);
+  FREE (avg_st);
+
+  /*
+    Step 2: leakage measurements
+  */
+  snprintf (buf, 1024, "%s.spi.mt0", file);
+  struct Hashtable *H = parse_measurements (buf);
+  if (!H) {
+    snprintf (buf, 1024, "%s.mt0", file);
+    H = parse_measurements (buf);
+    if (!H) {
+      FREE (vec);
+      return _fail (file, "Could not open measurement output file %s", buf);
+    }
+  }
+
+  MALLOC (leakage_power, double, (1 << _num_inputs));
+  for (int i=0; i < (1 << _num_inputs); i++) {
+    leakage_power[i] = 0;
+  }
+
+  hash_iter_t hi;
+  hash_bucket_t *b;
+
+  hash_iter_init (H, &hi);
+  while ((b = hash_iter_next (H, &hi))) {
+    int i;
+    double lk;
+    if (strncasecmp (b->key, "leak_", 5) == 0) {
+      if (sscanf (b->key + 5, "%d", &i) != 1) {
+	_fail (file, "Unknown measurement `%s'", b->key);
+	break;
+      }
+      lk = b->f;
+
+      if (lk < 0) {
+	warning ("%s: unusual measurement for leakage, scenario %d (%g)",
+		 _p->getName(), i, lk);
+	lk = -lk;
+      }
+      leakage_power[i] = lk;
+    }
+    else if (strncasecmp (b->key, "vchk_", 5) == 0) {
+      int s, j;
+      if (sscanf (b->key + 5, "%d_%d", &s, &j) != 2 || s >= nvec) {
+	_fail (file, "Unknown measurement `%s'", b->key);
+	break;
+      }
+      if (bitset_tst (_outvals[j], vec[s]) ?
+	  (b->f < config_get_real ("lint.V_high")) :
+	  (b->f > config_get_real ("lint.V_low"))) {
+	warning ("%s: out[%d] is %g V for input vector %d; production rules predict %d",
+		 _p->getName(), j, b->f, vec[s],
+		 !!bitset_tst (_outvals[j], vec[s]));
+      }
+    }
+  }
+  hash_free (H);
+  if (failed()) {
+    FREE (vec);
+    return 0;
+  }
+
+  if (_sparse) {
+    /* -- vectors that were not simulated use the average leakage -- */
+    double avg = 0;
+
+    _leak_sampled = bitset_new (1 << _num_inputs);
+    bitset_clear (_leak_sampled);
+    for (int i=0; i < nvec; i++) {
+      bitset_set (_leak_sampled, vec[i]);
+      avg += leakage_power[vec[i]];
+    }
+    avg /= nvec;
+    for (int i=0; i < (1 << _num_inputs); i++) {
+      if (!bitset_tst (_leak_sampled, i)) {
+	leakage_power[i] = avg;
+      }
+    }
+  }
+  FREE (vec);
+
+  if (logic_prs) {
+    unlink_generic (file);
+  }
+  else {
+    unlink_generic_trace (file);
+  }
+  
+  return 1;
+}
+
+
+/*
+  Read the truth tables for the outputs and state-holding nodes from
+  the leakage simulation trace. outname[] has the trace names of the
+  outputs followed by the internal state-holding nodes; vec[i] is
+  sampled at time sample[i] (in ps).
+*/
+int Cell::_read_leakage_trace (const char *file, char **outname, int nout,
+			       int nvec, unsigned int *vec, double *sample)
+{
+  char buf[1024];
+
   /* -- convert trace file to atrace format -- */
   if (config_get_int ("xcell.spice_output_fmt") == 0) {
     /* raw */
@@ -756,14 +1635,11 @@ int Cell::_run_leakage ()
   else {
     snprintf (buf, 1024, "tr2alint %s.tr0 %s", file, file);
   }
-  system (buf);
+  prof_system ("tr2alint", buf);
 
-  /* 
-     Step 1: truth tables
-  */
   atrace *tr = atrace_open (file);
   if (!tr) {
-    fatal_error ("Could not open simulation trace file!");
+    return _fail (file, "Could not open simulation trace file");
   }
   name_t *timenode;
   A_DECL (name_t *, outnode);
@@ -775,11 +1651,11 @@ int Cell::_run_leakage ()
     printf ("Time not found?\n");
   }
 
-  for (int i=0; i < A_LEN (outname); i++) {
+  for (int i=0; i < nout; i++) {
     A_NEWM (outnode, name_t *);
     A_NEXT (outnode) = atrace_lookup (tr, outname[i]);
     if (!A_NEXT (outnode)) {
-      if (i < num_outputs) {
+      if (i < _num_outputs) {
 	snprintf (buf, 1024, "p%d", i + _num_inputs);
 	A_NEXT (outnode) = atrace_lookup (tr, buf);
       }
@@ -795,46 +1671,45 @@ int Cell::_run_leakage ()
     }
   }
 
-  for (int i=0; i < A_LEN (outname); i++) {
-    FREE (outname[i]);
-  }
-  
-  if (A_LEN (outnode) != A_LEN (outname) || !timenode) {
+  if (A_LEN (outnode) != nout || !timenode) {
     A_FREE (outnode);
-    A_FREE (outname);
     atrace_close (tr);
-    A_FREE (_sh_vars);
-    return 0;
+    return _fail (file, "Output nodes missing from the simulation trace");
   }
-  
-  A_FREE (outname);
 
   int nnodes, nsteps, fmt, ts;
   if (atrace_header (tr, &ts, &nnodes, &nsteps, &fmt)) {
-    fatal_error ("Trace file header corrupted?");
+    A_FREE (outnode);
+    atrace_close (tr);
+    return _fail (file, "Trace file header corrupted?");
   }
 
   //printf ("%d nodes, %d steps\n", nnodes, nsteps);
 
   /* -- get values -- */
-  tm = 1;
+  int cur_step = 0;
   atrace_init_time (tr);
-  atrace_advance_time (tr, period*1e-12/ATRACE_GET_STEPSIZE (tr));
 
   float vhigh, vlow;
 
   vhigh = config_get_real ("lint.V_high");
   vlow = config_get_real ("lint.V_low");
 
+  _free_outvals ();
   MALLOC (_outvals, bitset_t *, A_LEN (outnode));
+  _num_outvals = A_LEN (outnode);
   for (int i=0; i < A_LEN (outnode); i++) {
     _outvals[i] = bitset_new (1 << _num_inputs);
   }
   
-  for (int i=0; i < (1 << _num_inputs); i++) {
+  for (int s=0; s < nvec; s++) {
     float val;
-    
-    atrace_advance_time (tr, (period-1000)*1e-12/ATRACE_GET_STEPSIZE (tr));
+    int step;
+    int i = vec[s];
+
+    step = sample[s]*1e-12/ATRACE_GET_STEPSIZE (tr);
+    atrace_advance_time (tr, step - cur_step);
+    cur_step = step;
 
     for (int j=0; j < A_LEN (outnode); j++) {
       val = ATRACE_NODE_FLOATVAL (outnode[j]);
@@ -848,66 +1723,120 @@ int Cell::_run_leakage ()
 	//printf ("out[%d]: L @ %g\n", j, ATRACE_NODE_FLOATVAL (timenode));
       }
       else {
-	if (j >= num_outputs) {
+	if (j >= _num_outputs) {
 	  warning ("%s: out[%d]: X (%g) @ %g\n", _p->getName(), j, val, ATRACE_NODE_FLOATVAL (timenode));
 	}
       }
     }
-    atrace_advance_time (tr, 1000e-12/ATRACE_GET_STEPSIZE (tr));
   }
   atrace_close (tr);
+  A_FREE (outnode);
 
-  /*
-    Step 2: leakage measurements
-  */
-  snprintf (buf, 1024, "%s.spi.mt0", file);
-  struct Hashtable *H = parse_measurements (buf);
-  if (!H) {
-    snprintf (buf, 1024, "%s.mt0", file);
-    H = parse_measurements (buf);
-    if (!H) {
-      fatal_error ("Could not open measurement output file %s.\n", buf);
+  return 1;
+}
+
+
+/*
+  Input vectors used for leakage. All of them in Gray code order, or
+  for sparse cells a sample of xcell.sparse.leak_samples vectors that
+  always includes the all-zero and all-one vectors.
+*/
+int Cell::_leakage_vectors (unsigned int **vecp)
+{
+  unsigned int *vec;
+  int nvec;
+
+  if (!_sparse) {
+    nvec = (1 << _num_inputs);
+    MALLOC (vec, unsigned int, nvec);
+    for (int i=0; i < nvec; i++) {
+      vec[i] = gray_code (i);
     }
+    *vecp = vec;
+    return nvec;
   }
 
-  MALLOC (leakage_power, double, (1 << _num_inputs));
-  for (int i=0; i < (1 << _num_inputs); i++) {
-    leakage_power[i] = 0;
-  }
+  /* -- sort the samples by position in the Gray code sequence, so
+     that successive vectors are close to each other -- */
+  unsigned int *rank;
+  int n = config_get_int ("xcell.sparse.leak_samples");
 
-  hash_iter_t hi;
-  hash_bucket_t *b;
+  if (n < 2) {
+    n = 2;
+  }
+  if (n > (1 << _num_inputs)) {
+    n = (1 << _num_inputs);
+  }
+  MALLOC (rank, unsigned int, n);
+  sample_vectors (_num_inputs, n, rank);
+  for (int i=0; i < n; i++) {
+    rank[i] = gray_rank (rank[i]);
+  }
+  qsort (rank, n, sizeof (unsigned int), _uint_cmp);
+  for (int i=0; i < n; i++) {
+    rank[i] = gray_code (rank[i]);
+  }
+  *vecp = rank;
+  return n;
+}
 
-  hash_iter_init (H, &hi);
-  while ((b = hash_iter_next (H, &hi))) {
-    int i;
-    double lk;
-    if (strncasecmp (b->key, "leak_", 5) == 0) {
-      if (sscanf (b->key + 5, "%d", &i) != 1) {
-	fatal_error ("Unknown measurement `%s'", b->key);
-      }
-      lk = b->f;
 
-      if (lk < 0) {
-	warning ("%s: unusual measurement for leakage, scenario %d (%g)",
-		 _p->getName(), i, lk);
-	lk = -lk;
-      }
-      leakage_power[i] = lk;
+/*
+  Initial conditions for the outputs and the internal state-holding
+  nodes, for input vector v at time zero, so that the simulator does
+  not have to find the state from an arbitrary DC solution. Returns 0
+  if nothing was emitted: either disabled, the truth tables are not
+  known yet, or some state-holding gate is not driven in vector v (its
+  value there depends on history, so there is no single right .ic).
+*/
+int Cell::_print_initial_state (FILE *fp, unsigned int v)
+{
+  int mode = config_get_int ("xcell.initial_state");
+  double vdd = config_get_real ("xcell.Vdd");
+  int x;
+
+  if (mode == 0 || !_outvals) {
+    return 0;
+  }
+
+  _calc_sh_inputs ();
+  for (int i=0; i < _num_stateholding; i++) {
+    if (!_stateholding[i].st[0] || !_stateholding[i].st[1]) {
+      return 0;
+    }
+    if (!!bitset_tst (_stateholding[i].st[0], v) ==
+	!!bitset_tst (_stateholding[i].st[1], v)) {
+      return 0;
     }
   }
-  hash_free (H);
 
-  unlink_generic_trace (file);
+  fprintf (fp, "\n* initial state\n");
+  fprintf (fp, "%s", mode == 1 ? ".nodeset" : ".ic");
+  for (int i=0; i < _num_outputs; i++) {
+    fprintf (fp, " V(p%d)=%g", _get_output_pin (i),
+	     bitset_tst (_outvals[i], v) ? vdd : 0.0);
+  }
+  x = _num_outputs;
+  for (int i=0; i < A_LEN (_sh_vars); i++) {
+    ActId *tmp;
+    char buf[1024];
+
+    if (_sh_vars[i]->isport) continue;
 
-  A_FREE (outnode);
-  
+    tmp = _sh_vars[i]->id->toid();
+    tmp->sPrint (buf, 1024);
+    delete tmp;
+    fprintf (fp, " V(xtst%s", config_get_string ("net.spice_path_sep"));
+    a->mfprintf (fp, "%s", buf);
+    fprintf (fp, ")=%g", bitset_tst (_outvals[x], v) ? vdd : 0.0);
+    x++;
+  }
+  fprintf (fp, "\n\n");
   return 1;
 }
 
 
-
-int Cell::_gen_spice_header (FILE *fp)
+int Cell::_gen_spice_header (FILE *fp, int probe)
 {
   A_DECL (int, xout);
   A_INIT (xout);
@@ -959,7 +1888,8 @@ int Cell::_gen_spice_header (FILE *fp)
     int sz;
     FILE *xfp = fopen (config_get_string (buf), "r");
     if (!xfp) {
-      fatal_error ("SPICE netlist `%s' not found", config_get_string (buf));
+      return _fail (NULL, "SPICE netlist `%s' not found",
+		    config_get_string (buf));
     }
     fprintf (fp, "\n*---- begin import from %s\n\n", buf);
     while ((sz = fread (buf, 1, 1024, xfp)) > 0) {
@@ -1000,7 +1930,16 @@ int Cell::_gen_spice_header (FILE *fp)
 
   /*-- load cap on output that is swept --*/
   for (int i=0; i < A_LEN (xout); i++) {
-    fprintf (fp, "Clc%d p%d GND load\n\n", i, xout[i]);
+    if (probe) {
+      /*-- I(Vlc) is the current into the load; the CCVS makes it a
+	node voltage (1V per A) in the trace --*/
+      fprintf (fp, "Vlc%d p%d lc%d 0\n", xout[i], xout[i], xout[i]);
+      fprintf (fp, "Hlc%d cc%d 0 Vlc%d 1\n", xout[i], xout[i], xout[i]);
+      fprintf (fp, "Clc%d lc%d GND load\n\n", i, xout[i]);
+    }
+    else {
+      fprintf (fp, "Clc%d p%d GND load\n\n", i, xout[i]);
+    }
   }
   A_FREE (xout);
 
@@ -1065,20 +2004,21 @@ int Cell::_get_output_pin (int pin)
 }
 
 
-void Cell::_print_all_input_cases (FILE *sfp, const char *prefix)
+/*
+  Scenario i applies input vector vec[i]. slot[i] is the start time of
+  scenario i; slot[nvec] is the end of the last slot.
+*/
+void Cell::_print_all_input_cases (FILE *sfp, const char *prefix,
+				   int nvec, unsigned int *vec, double *slot)
 {
-  double vdd = config_get_real ("xcell.Vdd");
-  double period = config_get_real ("xcell.period");
-
   /* -- leakage scenarios -- */
   
   for (int k=0; k < _num_inputs; k++) {
-    fprintf (sfp, "Vn%d %s%d 0 PWL (0p 0 1000p 0\n",
-	     _get_input_pin (k), prefix, _get_input_pin (k));
-    int tm = 1;
-    for (int i=0; i < (1 << _num_inputs); i++) {
-      print_window (sfp, tm*period+1, (tm+1)*period, (i >> k) & 0x1);
-      tm++;
+    double v0 = ((vec[0] >> k) & 1) ? config_get_real ("xcell.Vdd") : 0.0;
+    fprintf (sfp, "Vn%d %s%d 0 PWL (0p %g %gp %g\n",
+	     _get_input_pin (k), prefix, _get_input_pin (k), v0, slot[0], v0);
+    for (int i=0; i < nvec; i++) {
+      print_window (sfp, slot[i]+1, slot[i+1], (vec[i] >> k) & 0x1);
     }
     fprintf (sfp, "+)\n\n");
   }
@@ -1088,97 +2028,77 @@ void Cell::_print_all_input_cases (FILE *sfp, const char *prefix)
 void Cell::_emit_leakage ()
 {
   int i;
-  char buf[1024];
 
-  if (!nl) return;
+  if (!_has_data()) return;
+
+  /*-- input vectors where a state-holding gate has both its pull-up
+    and pull-down on --*/
+  bitset_t *interf = NULL;
+  if (!_is_dataflow && _num_stateholding > 0) {
+    unsigned int nvec = (1U << _num_inputs);
+    _calc_sh_inputs ();
+    interf = bitset_new (nvec);
+    bitset_clear (interf);
+    for (unsigned int base=0; base < nvec; base += LOGIC_WORD_BITS) {
+      logic_word_t w = 0;
+      for (int k=0; k < _num_stateholding; k++) {
+	w |= logic_get_word (_stateholding[k].st[0], base, nvec) &
+	  logic_get_word (_stateholding[k].st[1], base, nvec);
+      }
+      logic_set_word (interf, base, w);
+    }
+  }
 
   for (int i=0; i < (1 << _num_inputs); i++) {
     double lk = leakage_power[i];
 
-    if (!_is_dataflow) {
-      /*-- now check for interference --*/
-
-      /*--
-	Primary inputs are set by "i"
-	Secondary inputs are set by bitset outval[...]
-	--*/
-
-      unsigned int val = 0;
-      int loc = _num_outputs;
-      
-      /* -- compute variable assignment -- */
-      for (int k=0; k < A_LEN (_sh_vars); k++) {
-	/* search in port list */
-	if (_sh_vars[k]->isport) {
-	  int j;
-	  int pos = 0;
-	  int opos = 0;
-	  for (j=0; j < A_LEN (nl->bN->ports); j++) {
-	    if (nl->bN->ports[j].omit) continue;
-	    if (nl->bN->ports[j].c == _sh_vars[k]->id) {
-	      break;
-	    }
-	    if (nl->bN->ports[j].input) {
-	      pos++;
-	    }
-	    else {
-	      opos++;
-	    }
-	  }
-	  Assert (j != A_LEN (nl->bN->ports), "What?!");
-
-	  if (nl->bN->ports[j].input) {
-	    if ((i >> pos) & 1) {
-	      val = val | (1 << k);
-	    }
-	  }
-	  else {
-	    /* it's an output! */
-	    if (bitset_tst (_outvals[opos], i)) {
-	      val = val | (1 << k);
-	    }
-	  }
-	}
-	else {
-	  if (bitset_tst (_outvals[loc], i)) {
-	    val = val | (1 << k);
-	  }
-	  loc++;
-	}
-      }
+    if (_leak_sampled && !bitset_tst (_leak_sampled, i)) {
+      /* -- not simulated -- */
+      continue;
+    }
 
-      int flag = 0;
-      for (int i=0; i < _num_stateholding; i++) {
-	if (bitset_tst (_stateholding[i].tt[0], val) &&
-	    bitset_tst (_stateholding[i].tt[1], val)) {
-	  flag = 1;
-	  break;
-	}
-      }
-      if (flag) {
-	/* -- interference -- */
-	continue;
-      }
+    if (interf && bitset_tst (interf, i)) {
+      /* -- interference -- */
+      continue;
     }
       
     CNLFP (_lfp, "leakage_power() {\n");
     _l->_tab();
     CNLFP (_lfp, "when : \"");
     for (int k=0; k < _num_inputs; k++) {
-      _sprint_input_pin (buf, 1024, k);
       if (k > 0) {
 	fprintf (_lfp, "&");
       }
       if (((i >> k) & 1) == 0) {
 	fprintf (_lfp, "!");
       }
-      a->mfprintf (_lfp, "%s", buf);
+      fputs (_lib_pin (k), _lfp);
     }
     fprintf (_lfp, "\";\n");
     CNLFP (_lfp, "value : %g;\n", lk/config_get_real ("xcell.units.power_conv"));
     _l->_untab();
     CNLFP (_lfp, "}\n");
   }
+
+  if (_leak_sampled) {
+    /* -- default for the vectors that were not simulated; they were
+       all set to the average of the sampled ones -- */
+    for (int i=0; i < (1 << _num_inputs); i++) {
+      if (!bitset_tst (_leak_sampled, i)) {
+	CNLFP (_lfp, "leakage_power() {\n");
+	_l->_tab();
+	CNLFP (_lfp, "value : %g;\n",
+	       leakage_power[i]/config_get_real ("xcell.units.power_conv"));
+	_l->_untab();
+	CNLFP (_lfp, "}\n");
+	break;
+      }
+    }
+  }
+
+  if (interf) {
+    bitset_free (interf);
+  }
 }
 
 
@@ -1203,13 +2123,14 @@ int Cell::_run_input_cap ()
   snprintf (buf, 1024, "%s.spi", file);
   sfp = fopen (buf, "w");
   if (!sfp) {
-    fatal_error ("Could not open `%s' for writing", buf);
+    return _fail (NULL, "Could not open `%s' for writing", buf);
   }
   if (!_gen_spice_header (sfp)) {
     fclose (sfp);
     unlink (buf);
     return 0;
   }
+  print_sim_options (sfp, config_get_string ("xcell.accuracy"));
 
   /* -- resis to input -- */
 
@@ -1222,18 +2143,56 @@ int Cell::_run_input_cap ()
   }
   fprintf (sfp, "\n");
 
-  _print_input_cap_cases (sfp, "q");
-
-  /* measure input delays! */
-
-  double period = config_get_real ("xcell.period");
   double vdd = config_get_real ("xcell.Vdd");
   double window = config_get_real ("xcell.short_window");
 
+  /* -- states of the other inputs: all of them, or a sample for
+     sparse cells -- */
+  int nq;
+  unsigned int *qv;
+
+  if (_sparse) {
+    nq = config_get_int ("xcell.sparse.cap_samples");
+    if (nq < 1) {
+      nq = 1;
+    }
+    if (nq > (1 << (_num_inputs-1))) {
+      nq = (1 << (_num_inputs-1));
+    }
+    MALLOC (qv, unsigned int, nq);
+    sample_vectors (_num_inputs-1, nq, qv);
+  }
+  else {
+    nq = (1 << (_num_inputs-1));
+    MALLOC (qv, unsigned int, nq);
+    for (int i=0; i < nq; i++) {
+      qv[i] = i;
+    }
+  }
+
+  /* -- plan the time slots: each one toggles an input twice -- */
+  int nslots = _num_inputs*nq;
+  struct timeline tl;
+  double *slot;
+
+  /* -- all inputs start at 0 -- */
+  timeline_init (&tl, _print_initial_state (sfp, 0) ?
+		 config_get_real ("xcell.ic_hold") : 1000);
+  MALLOC (slot, double, nslots + 1);
+  for (int i=0; i < nslots; i++) {
+    slot[i] = timeline_alloc (&tl, 5*window);
+  }
+  slot[nslots] = timeline_end (&tl);
+
+  _print_input_cap_cases (sfp, "q", nq, qv, slot);
+  FREE (qv);
+
+  /* measure input delays! */
+
   double cap_meas = config_get_real ("xcell.cap_measure");
   for (int i=0; i < _num_inputs; i++) {
-    for (int j=0; j < ((1 << (_num_inputs-1))); j++) {
-      double my_start = i*(1 << (_num_inputs-1))*period + period + period*j;
+    for (int j=0; j < nq; j++) {
+      double my_start = slot[i*nq + j];
       
       fprintf (sfp, ".measure tran cap_tup_%d_%d_0 trig V(q%d) VAL=%g TD=",
 	       i, j, _get_input_pin (i), vdd*0.05);
@@ -1261,18 +2220,26 @@ int Cell::_run_input_cap ()
     }
   }
 
-  fprintf (sfp, ".tran 0.1p %gp\n",
-	   _num_inputs * ((1 << (_num_inputs-1))) * period + period);
+  print_tran (sfp, config_get_string ("xcell.accuracy"), timeline_end (&tl));
+  fprintf (sfp, "\n");
+  FREE (slot);
   
   if (is_hspice()) {
     fprintf (sfp, ".options measform=2\n");
   }
   fprintf (sfp, "\n.end\n");
   fclose (sfp);
+  snprintf (buf, 1024, "%s.spi", file);
+  prof_deck (buf, timeline_end (&tl), 0);
+  double limit = wd_limit (buf, timeline_end (&tl), 1);
 
   snprintf (buf, 1024, "%s %s.spi > %s.log 2>&1",
 	    config_get_string ("xcell.spice_binary"), file, file);
-  system (buf);
+  if (prof_system ("sim", buf, limit) == JOBS_TIMEOUT) {
+    snprintf (buf, 1024, "%s.spi", file);
+    wd_timeout (buf, limit, "cell failed");
+    return _fail (file, "Input capacitance simulation timed out");
+  }
 
 
   int *upcnt, *dncnt;
@@ -1293,7 +2260,9 @@ int Cell::_run_input_cap ()
     snprintf (buf, 1024, "%s.mt0", file);
     H = parse_measurements (buf);
     if (!H) {
-      fatal_error ("Could not open measurement output from simulation.\n");
+      FREE (upcnt);
+      FREE (dncnt);
+      return _fail (file, "Could not open measurement output file %s", buf);
     }
   }
 
@@ -1307,7 +2276,8 @@ int Cell::_run_input_cap ()
     double tm;
     if (strncasecmp (b->key, "cap_tup_", 8) == 0) {
       if (sscanf (b->key + 8, "%d_%d", &i, &j) != 2) {
-	fatal_error ("Unknown measurement: %s", b->key);
+	_fail (file, "Unknown measurement `%s'", b->key);
+	break;
       }
       tm = b->f;
       if (tm < 0) {
@@ -1319,7 +2289,8 @@ int Cell::_run_input_cap ()
     }
     else if (strncasecmp (b->key, "cap_tdn_", 8) == 0) {
       if (sscanf (b->key + 8, "%d_%d", &i, &j) != 2) {
-	fatal_error ("Unknown measurement: %s", b->key);
+	_fail (file, "Unknown measurement `%s'", b->key);
+	break;
       }
       tm = b->f;
       if (tm < 0) {
@@ -1365,50 +2336,53 @@ int Cell::_run_input_cap ()
 
 void Cell::_emit_input_cap ()
 {
-  char buf[1024];
-  
-  if (!nl) return;
+  if (!_has_data()) return;
   
   for (int i=0; i < _num_inputs; i++) {
-    _sprint_input_pin (buf, 1024, i);
     CNLFP (_lfp, "pin(");
-    a->mfprintf (_lfp, "%s", buf);  fprintf (_lfp, ") {\n");
+    fputs (_lib_pin (i), _lfp);
+    fprintf (_lfp, ") {\n");
     _l->_tab();
     CNLFP (_lfp, "direction : input;\n");
     CNLFP (_lfp, "rise_capacitance : %g;\n", time_up[i]/config_get_real ("xcell.units.cap_conv"));
     CNLFP (_lfp, "fall_capacitance : %g;\n", time_dn[i]/config_get_real ("xcell.units.cap_conv"));
+    _emit_seq_constraints (i);
     _l->_untab();
     CNLFP (_lfp, "}\n");
   }
 }
 
 
-void Cell::_print_input_cap_cases (FILE *sfp, const char *prefix)
+/*
+  slot[] has the start time of each slot, followed by the end time of
+  the last one. Input i is toggled in slots i*nq ... (i+1)*nq-1, with
+  the other inputs set from qv[0] ... qv[nq-1]
+*/
+void Cell::_print_input_cap_cases (FILE *sfp, const char *prefix,
+				   int nq, unsigned int *qv, double *slot)
 {
-  double vdd = config_get_real ("xcell.Vdd");
-  double period = config_get_real ("xcell.period");
   double window = config_get_real ("xcell.short_window");
 
   for (int i=0; i < _num_inputs; i++) {
 
-    fprintf (sfp, "Vn%d %s%d 0 PWL (0p 0 1000p 0\n",
-	     _get_input_pin (i), prefix, _get_input_pin (i));
+    fprintf (sfp, "Vn%d %s%d 0 PWL (0p 0 %gp 0\n",
+	     _get_input_pin (i), prefix, _get_input_pin (i), slot[0]);
     
     /*-- we run input i up and down 2 times, with the others being in
       all possible different states --*/
-    int tm = 1;
+    int tm = 0;
 
     /* prefix: just go through all possible cases */
     for (int p=0; p < i; p++) {
-      for (int q=0; q < (1 << (_num_inputs-1)); q++) {
-	print_window (sfp, tm*period + 1, (tm+1)*period, (q >> (i-1)) & 1);
+      for (int q=0; q < nq; q++) {
+	print_window (sfp, slot[tm] + 1, slot[tm+1], (qv[q] >> (i-1)) & 1);
 	tm++;
       }
     }
 
     /* -- now it is my turn -- */
-    for (int q=0; q < (1 << (_num_inputs-1)); q++) {
-      double offset = tm*period;
+    for (int q=0; q < nq; q++) {
+      double offset = slot[tm];
       print_window (sfp, offset+1, offset+window, 0);
       offset += window;
       print_window (sfp, offset+1, offset+window, 1);
@@ -1417,18 +2391,14 @@ void Cell::_print_input_cap_cases (FILE *sfp, const char *prefix)
       offset += window;
       print_window (sfp, offset+1, offset+window, 1);
       offset += window;
-      print_window (sfp, offset+1, offset+window, 0);
-      offset += window;
+      print_window (sfp, offset+1, slot[tm+1], 0);
       tm++;
-      if (offset >= tm*period) {
-	warning ("Period (%g) needs to be >= short_window (%g)*5\n", period, window);
-      }
     }
 
     /* -- now rest -- */
     for (int p=i+1; p < _num_inputs; p++) {
-      for (int q=0; q < (1 << (_num_inputs-1)); q++) {
-	print_window (sfp, tm*period+1, (tm+1)*period, (q >> i) & 1);
+      for (int q=0; q < nq; q++) {
+	print_window (sfp, slot[tm]+1, slot[tm+1], (qv[q] >> i) & 1);
 	tm++;
       }
     }
@@ -1444,46 +2414,91 @@ void Cell::_print_input_case (int idx, int skipmask)
 
 void Cell::_print_input_case (FILE *fp, int idx, int skipmask)
 {
-  char buf[1024];
-  ActId *tmp;
   int first = 1;
   
   for (int j=0; j < _num_inputs; j++) {
     if (skipmask & (1 << j)) continue;
     
     if (!first) {
-      fprintf (fp, "*");
+      fputc ('*', fp);
     }
     first = 0;
 	    
     if (!((idx >> j) & 1)) {
-      fprintf (fp, "!");
+      fputc ('!', fp);
     }
-    _sprint_input_pin (buf, 1024, j);
-    a->mfprintf (fp, "%s", buf);
+    fputs (_lib_pin (j), fp);
   }
 }
 
 
-static int find_driven_assignment (bitset_t *b, bitset_t *bopp,
-				   int ninputs, int bit_pos, int bit_val,
-				   int base_idx)
+int Cell::_print_sop (bitset_t *b)
 {
-  int idx;
-  int i;
+  struct logic_cube *c;
+  int n;
+  int mask = (1 << _num_inputs) - 1;
+
+  if (config_get_int ("xcell.lib_minimize")) {
+    c = logic_sop (_num_inputs, b, NULL, &n);
+    for (int i=0; i < n; i++) {
+      if (i != 0) {
+	fputc ('+', _lfp);
+      }
+      if (c[i].care == 0) {
+	fputc ('1', _lfp);
+      }
+      else {
+	_print_input_case (c[i].val, mask & ~c[i].care);
+      }
+    }
+    if (c) {
+      FREE (c);
+    }
+    return n;
+  }
 
-  i = 0;
+  n = 0;
+  for (int i=0; i < (1 << _num_inputs); i++) {
+    if (bitset_tst (b, i)) {
+      if (n != 0) {
+	fputc ('+', _lfp);
+      }
+      n++;
+      _print_input_case (i);
+    }
+  }
+  return n;
+}
 
-  for (i = 0; i < (1 << (ninputs-1)); i++) {
-    idx = (((unsigned)i >> (bit_pos)) << (bit_pos+1)) |
-      (bit_val << bit_pos) | (i & ((1 << bit_pos)-1));
 
-    if (bitset_tst (b, idx) && !bitset_tst (bopp, idx)) {
-      break;
+/*
+  Smallest input vector with bit bit_pos equal to bit_val where b is
+  set and bopp is not, a word of vectors at a time; -1 if none.
+*/
+static int first_driven (bitset_t *b, bitset_t *bopp, int ninputs,
+			 int bit_pos, int bit_val)
+{
+  unsigned int nvec = (1U << ninputs);
+
+  for (unsigned int base=0; base < nvec; base += LOGIC_WORD_BITS) {
+    logic_word_t sel = logic_enum_word (bit_pos, base);
+    logic_word_t w = logic_get_word (b, base, nvec) &
+      ~logic_get_word (bopp, base, nvec) & (bit_val ? sel : ~sel);
+    if (w) {
+      return base + __builtin_ctzll (w);
     }
   }
+  return -1;
+}
+
+static int find_driven_assignment (bitset_t *b, bitset_t *bopp,
+				   int ninputs, int bit_pos, int bit_val,
+				   int base_idx)
+{
+  int idx;
 
-  if (i == (1 << (ninputs-1))) {
+  idx = first_driven (b, bopp, ninputs, bit_pos, bit_val);
+  if (idx == -1) {
     return -1;
   }
 
@@ -1516,20 +2531,9 @@ static int find_multi_driven_assignment (bitset_t *b, bitset_t *bopp,
 					 int base_idx)
 {
   int idx;
-  int i;
-
-  i = 0;
-
-  for (i = 0; i < (1 << (ninputs-1)); i++) {
-    idx = (((unsigned)i >> (bit_pos)) << (bit_pos+1)) |
-      ((1-bit_val) << bit_pos) | (i & ((1 << bit_pos)-1));
-
-    if (bitset_tst (b, idx) && !bitset_tst (bopp, idx)) {
-      break;
-    }
-  }
 
-  if (i == (1 << (ninputs-1))) {
+  idx = first_driven (b, bopp, ninputs, bit_pos, 1-bit_val);
+  if (idx == -1) {
     return -1;
   }
 
@@ -1554,6 +2558,103 @@ static int find_multi_driven_assignment (bitset_t *b, bitset_t *bopp,
 }
 
 
+/*------------------------------------------------------------------------
+ *
+ *  Evaluate the pull-up and pull-down of each state-holding gate for
+ *  every primary input vector (st[1], st[0]), using the compiled
+ *  guards. Each variable in _sh_vars is either a primary input, whose
+ *  word is just the enumeration pattern, or an output/internal node
+ *  whose value comes from the truth tables in _outvals.
+ *
+ *------------------------------------------------------------------------
+ */
+void Cell::_calc_sh_inputs ()
+{
+  int *src;			/* >= 0 : input; < 0 : -(outvals idx)-1 */
+  int xpos;
+  unsigned int nvec = (1U << _num_inputs);
+  logic_word_t *var, *stack;
+  int depth;
+
+  if (_num_stateholding == 0 || _stateholding[0].st[0]) {
+    return;
+  }
+
+  MALLOC (src, int, A_LEN (_sh_vars));
+  xpos = 0;
+  for (int i=0; i < A_LEN (_sh_vars); i++) {
+    int pos = 0;
+    int opos = 0;
+    int j;
+    for (j=0; j < A_LEN (nl->bN->ports); j++) {
+      if (nl->bN->ports[j].omit) continue;
+      if (nl->bN->ports[j].c == _sh_vars[i]->id) {
+	break;
+      }
+      if (nl->bN->ports[j].input) {
+	pos++;
+      }
+      else {
+	opos++;
+      }
+    }
+    if (j == A_LEN (nl->bN->ports)) {
+      if (_sh_vars[i]->isport) {
+	fatal_error ("Map error?");
+      }
+      src[i] = -(_num_outputs + xpos) - 1;
+      xpos++;
+    }
+    else if (nl->bN->ports[j].input) {
+      src[i] = pos;
+    }
+    else {
+      src[i] = -opos - 1;
+    }
+  }
+
+  depth = 1;
+  for (int i=0; i < _num_stateholding; i++) {
+    struct stateholding_info *sh = &_stateholding[i];
+    sh->st[0] = bitset_new (nvec); /* pull-down */
+    bitset_clear (sh->st[0]);
+    sh->st[1] = bitset_new (nvec); /* pull-up */
+    bitset_clear (sh->st[1]);
+    for (int k=0; k < 2; k++) {
+      if (sh->prog[k]->depth > depth) {
+	depth = sh->prog[k]->depth;
+      }
+    }
+  }
+
+  MALLOC (var, logic_word_t, A_LEN (_sh_vars));
+  MALLOC (stack, logic_word_t, depth);
+
+  for (unsigned int base=0; base < nvec; base += LOGIC_WORD_BITS) {
+    logic_word_t mask = logic_mask (base, nvec);
+    for (int i=0; i < A_LEN (_sh_vars); i++) {
+      if (src[i] >= 0) {
+	var[i] = logic_enum_word (src[i], base);
+      }
+      else {
+	var[i] = logic_get_word (_outvals[-src[i]-1], base, nvec);
+      }
+    }
+    for (int i=0; i < _num_stateholding; i++) {
+      struct stateholding_info *sh = &_stateholding[i];
+      for (int k=0; k < 2; k++) {
+	logic_set_word (sh->st[k], base,
+			logic_eval (sh->prog[k], var, stack) & mask);
+      }
+    }
+  }
+
+  FREE (var);
+  FREE (stack);
+  FREE (src);
+}
+
+
 void Cell::_calc_dynamic ()
 {
   if (_is_dataflow) {
@@ -1566,11 +2667,17 @@ void Cell::_calc_dynamic ()
   }
 
   A_INIT (dyn);
+  _user_dyn = 0;
   
   if (!nl) {
     return;
   }
 
+  /* -- sequential cells are handled by _run_sequential -- */
+  if (_is_external && _ext_type) {
+    return;
+  }
+
   /* Run dynamic scenarios.
 
      If there's a state-holding node, build state-holding truth table
@@ -1626,6 +2733,7 @@ void Cell::_calc_dynamic ()
 	}
 	A_INC (dyn);
       }
+      _user_dyn = A_LEN (dyn);
 
       snprintf (buf, 1024, "%s.scenario.function", cprefix);
       if (config_exists (buf)) {
@@ -1642,115 +2750,14 @@ void Cell::_calc_dynamic ()
       _is_out[i] = 0;
     }
     
+    /* -- pull-up/pull-down as a function of the primary inputs -- */
+    _calc_sh_inputs ();
+
     for (int sv=0; sv < _num_stateholding; sv++) {
       int sh_outvar;
-      int *iomap;
-      int *xmap;
-      int xcount;
       int *is_out;
       struct stateholding_info *sh = &_stateholding[sv];
     
-      /* -- we know the truth table for the pull-up and pull-down, so
-	 create it based directly on input 
-	 --*/
-      sh->st[0] = bitset_new (1 << _num_inputs); /* pull-down */
-      bitset_clear (sh->st[0]);
-      sh->st[1] = bitset_new (1 << _num_inputs); /* pull-up */
-      bitset_clear (sh->st[1]);
-
-      MALLOC (iomap, int, _num_inputs + _num_outputs);
-      for (int i=0; i < _num_inputs + _num_outputs; i++) {
-	iomap[i] = -1;
-      }
-
-      xcount = 0;
-      for (int i=0; i < A_LEN (_sh_vars); i++) {
-	if (_sh_vars[i]->isport) continue;
-	xcount++;
-      }
-
-      if (xcount > 0) {
-	MALLOC (xmap, int, xcount);
-	for (int i=0; i < xcount; i++) {
-	  xmap[i] = -1;
-	}
-      }
-
-      /* build map from sh_vars to inputs */
-      for (int i=0; i < A_LEN (_sh_vars); i++) {
-	int pos = 0;
-	int opos = _num_inputs;
-	int xpos = 0;
-	for (int j=0; j < A_LEN (nl->bN->ports); j++) {
-	  if (nl->bN->ports[j].omit) continue;
-	  if (nl->bN->ports[j].c == _sh_vars[i]->id) {
-	    if (nl->bN->ports[j].input) {
-	      iomap[pos] = i;
-	    }
-	    else {
-	      iomap[opos] = i;
-	    }
-	    break;
-	  }
-	  if (nl->bN->ports[j].input) {
-	    pos++;
-	  }
-	  else {
-	    opos++;
-	  }
-	}
-	if (pos >= _num_inputs && opos >= (_num_inputs + _num_outputs)) {
-	  if (_sh_vars[i]->isport) {
-	    fatal_error ("Map error?");
-	  }
-	  else {
-	    Assert (xpos < xcount, "Hmmm");
-	    xmap[xpos] = i;
-	    xpos++;
-	  }
-	}
-      }
-
-      for (int i=0; i < (1 << _num_inputs); i++) {
-	unsigned int idx = 0;
-
-	for (int j=0; j < _num_inputs; j++) {
-	  if (iomap[j] != -1) {
-	    if ((i >> j) & 0x1) {
-	      idx |= (1 << iomap[j]);
-	    }
-	  }
-	}
-
-	for (int j=0; j < _num_outputs; j++) {
-	  if (iomap[_num_inputs + j] != -1) {
-	    if (bitset_tst (_outvals[j], i)) {
-	      idx |= (1 << iomap[_num_inputs + j]);
-	    }
-	  }
-	}
-
-	for (int j=0; j < xcount; j++) {
-	  if (xmap[j] != -1) {
-	    if (bitset_tst (_outvals[j + _num_outputs], i)) {
-	      idx |= (1 << xmap[j]);
-	    }
-	  }
-	}
-
-	if (bitset_tst (sh->tt[0], idx)) {
-	  bitset_set (sh->st[0], i);
-	}
-	if (bitset_tst (sh->tt[1], idx)) {
-	  bitset_set (sh->st[1], i);
-	}
-      }
-      if (xcount > 0) {
-	FREE (xmap);
-      }
-      FREE (iomap);
-      
-
       /* -- 
 	 if sh is not a port, then check if there is an output that's
 	 exactly the complement of this variable
@@ -1762,51 +2769,30 @@ void Cell::_calc_dynamic ()
       }
       /* -1 = new, -2 = no, 0 = non-inv, 1 = inv */
 
-      for (int i=0; i < (1 << _num_inputs); i++) {
-	if (bitset_tst (sh->st[0], i)) {
-	  /* pull-down is 1 */
-	  for (int j=0; j < _num_outputs; j++) {
-	    if (is_out[j] == -2) continue;
-	    if (bitset_tst (_outvals[j], i)) {
-	      if (is_out[j] == -1) {
-		is_out[j] = 1;
-	      }
-	      else if (is_out[j] != 1) {
-		is_out[j] = -2;
-	      }
-	    }
-	    else {
-	      if (is_out[j] == -1) {
-		is_out[j] = 0;
-	      }
-	      else if (is_out[j] != 0) {
-		is_out[j] = -2;
-	      }
-	    }
+      /* -- an output matches if, wherever the gate is driven, it
+	 agrees with the pull-down (inverted) or pull-up (non-inverted)
+	 -- */
+      for (int j=0; j < _num_outputs; j++) {
+	int inv_ok = 1, noninv_ok = 1, driven = 0;
+	for (unsigned int base=0; base < (1U << _num_inputs);
+	     base += LOGIC_WORD_BITS) {
+	  logic_word_t d0, d1, out;
+	  d0 = logic_get_word (sh->st[0], base, 1 << _num_inputs);
+	  d1 = logic_get_word (sh->st[1], base, 1 << _num_inputs) & ~d0;
+	  out = logic_get_word (_outvals[j], base, 1 << _num_inputs);
+	  if ((d0 & ~out) || (d1 & out)) {
+	    inv_ok = 0;
 	  }
-	}
-	else if (bitset_tst (sh->st[1], i)) {
-	  /* pull-up is 1 */
-	  for (int j=0; j < _num_outputs; j++) {
-	    if (is_out[j] == -2) continue;
-	    if (!bitset_tst (_outvals[j], i)) {
-	      if (is_out[j] == -1) {
-		is_out[j] = 1;
-	      }
-	      else if (is_out[j] != 1) {
-		is_out[j] = -2;
-	      }
-	    }
-	    else {
-	      if (is_out[j] == -1) {
-		is_out[j] = 0;
-	      }
-	      else if (is_out[j] != 0) {
-		is_out[j] = -2;
-	      }
-	    }
+	  if ((d0 & out) || (d1 & ~out)) {
+	    noninv_ok = 0;
+	  }
+	  if (d0 | d1) {
+	    driven = 1;
 	  }
 	}
+	if (driven) {
+	  is_out[j] = inv_ok ? 1 : (noninv_ok ? 0 : -2);
+	}
       }
 
       sh_outvar = -1;
@@ -1846,6 +2832,17 @@ void Cell::_calc_dynamic ()
 
   /* -- create dynamic scenarios -- */
 
+  /*-- sparse cells only need one sensitizing assignment per arc;
+    covered[] records the arcs (output, input, direction) found --*/
+  char *covered = NULL;
+#define ARC_ID(o,j,ii,oi) ((((o)*_num_inputs + (j))*2 + (ii))*2 + (oi))
+  if (_sparse) {
+    MALLOC (covered, char, _num_outputs*_num_inputs*4);
+    for (int i=0; i < _num_outputs*_num_inputs*4; i++) {
+      covered[i] = 0;
+    }
+  }
+
   for (int nout=0; nout < _num_outputs; nout++) {
     int pos = _get_output_pin (nout);
 
@@ -1880,6 +2877,10 @@ void Cell::_calc_dynamic ()
 
 	  for (int j=0; j < _num_inputs; j++) {
 	    unsigned int opp = i ^ (1 << j);
+	    int arc_id = ARC_ID (nout, j, (opp >> j) & 1,
+				 (drive_up ? 0 : 1) ^ (_is_out[nout] > 0 ? 0 : 1));
+
+	    if (covered && covered[arc_id]) continue;
 
 	    /* flip bit j: if this turns the gate SH or opp driven,
 	       we have a scenario */
@@ -1896,6 +2897,7 @@ void Cell::_calc_dynamic ()
 		A_NEXT (dyn).out_init = (drive_up ? 0 : 1) ^
 		  (_is_out[nout] > 0 ? 0 : 1);
 		A_INC (dyn);
+		if (covered) covered[arc_id] = 1;
 		
 		//printf (" flip %d (comb)\n", j);
 	      }
@@ -1916,6 +2918,7 @@ void Cell::_calc_dynamic ()
 		  A_NEXT (dyn).out_init = (drive_up ? 0 : 1) ^
 		    (_is_out[nout] > 0 ? 0 : 1);
 		  A_INC (dyn);
+		  if (covered) covered[arc_id] = 1;
 		
 		  //printf (" flip %d (sh) ... from ", j);
 		  //_print_input_case (stdout, a, nl, num_inputs, k);
@@ -1944,6 +2947,7 @@ void Cell::_calc_dynamic ()
 		    A_NEXT (dyn).out_init = (drive_up ? 0 : 1) ^
 		      (_is_out[nout] > 0 ? 0 : 1);
 		    A_INC (dyn);
+		    if (covered) covered[arc_id] = 1;
 		    
 		    //printf (" flip %d (sh) ... from ", j);
 		    //_print_input_case (stdout, a, nl, num_inputs, k);
@@ -1965,6 +2969,10 @@ void Cell::_calc_dynamic ()
 	for (int j=0; j < _num_inputs; j++) {
 	  /* -- current bit being checked: j -- */
 	  unsigned int opp = i ^ (1 << j);
+	  int arc_id = ARC_ID (nout, j, (opp >> j) & 1,
+			       !!bitset_tst (_outvals[nout], opp));
+
+	  if (covered && covered[arc_id]) continue;
 
 	  /* _outvals has truth table for output */
 	  if ((!!bitset_tst (_outvals[nout], i)) !=
@@ -1979,6 +2987,7 @@ void Cell::_calc_dynamic ()
 	    A_NEXT (dyn).in_init = ((opp >> j) & 1);
 	    A_NEXT (dyn).out_init = !!bitset_tst (_outvals[nout], opp);
 	    A_INC (dyn);
+	    if (covered) covered[arc_id] = 1;
 #if 0	    
 	    printf ("input: %d -> %d : ", (opp >> j) & 1, (i >> j) & 1);
 	    _print_input_case (stdout, a, nl, num_inputs, i);
@@ -1990,6 +2999,10 @@ void Cell::_calc_dynamic ()
       }
     }
   }
+#undef ARC_ID
+  if (covered) {
+    FREE (covered);
+  }
 
 #if 0
   for (int i=0; i < A_LEN (dyn); i++) {
@@ -2008,19 +3021,331 @@ void Cell::_calc_dynamic ()
   }
 #endif
 }
-  
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Group dynamic cases that use the same input sequence into a single
+ *  scenario. For multi-output cells the same input sequence can
+ *  toggle several outputs, and all of them can be measured from one
+ *  simulation slot.
+ *
+ *------------------------------------------------------------------------
+ */
+void Cell::_calc_scenarios ()
+{
+  struct Hashtable *H;
+  hash_bucket_t *b;
+  char buf[128];
+
+  if (A_LEN (dscen) > 0) {
+    /* already computed! */
+    return;
+  }
+
+  H = hash_new (8);
+
+  for (int i=0; i < A_LEN (dyn); i++) {
+    int len;
+
+    len = snprintf (buf, 128, "%d", dyn[i].nidx);
+    for (int k=0; k < dyn[i].nidx; k++) {
+      len += snprintf (buf + len, 128 - len, ":%d", dyn[i].idx[k]);
+    }
+
+    b = hash_lookup (H, buf);
+    if (b) {
+      dyn[i].scen = b->i;
+      dscen[b->i].narcs++;
+      if (i < _user_dyn) {
+	dscen[b->i].user = 1;
+      }
+      continue;
+    }
+    b = hash_add (H, buf);
+    b->i = A_LEN (dscen);
+
+    A_NEW (dscen, struct dynamic_scenario);
+    A_NEXT (dscen).nidx = dyn[i].nidx;
+    for (int k=0; k < dyn[i].nidx; k++) {
+      A_NEXT (dscen).idx[k] = dyn[i].idx[k];
+    }
+    A_NEXT (dscen).in_id = dyn[i].in_id;
+    A_NEXT (dscen).in_init = dyn[i].in_init;
+    A_NEXT (dscen).narcs = 1;
+    A_NEXT (dscen).skip = 0;
+    A_NEXT (dscen).user = (i < _user_dyn);
+    A_INC (dscen);
+
+    dyn[i].scen = b->i;
+  }
+  hash_free (H);
+
+  if (verbose && A_LEN (dscen) != A_LEN (dyn)) {
+    printf (" %d dynamic cases share %d scenarios\n", A_LEN (dyn),
+	    A_LEN (dscen));
+  }
+
+  if (config_get_int ("xcell.chain_scenarios")) {
+    _schedule_scenarios ();
+  }
+}
+
+
+static int _int_cmp (const void *a, const void *b)
+{
+  int x = *((const int *)a);
+  int y = *((const int *)b);
+  if (x < y) return -1;
+  if (x > y) return 1;
+  return 0;
+}
+
+/*------------------------------------------------------------------------
+ *
+ *  Order the scenarios so that one scenario ends in the input vector
+ *  used to initialize the next one, so that the initialization step
+ *  can be skipped.
+ *
+ *  The first step of every scenario (idx[0]) is a vector that fully
+ *  determines the state being measured, so it can be shared with the
+ *  last step of the previous scenario.
+ *
+ *  Input vectors are nodes and scenarios are edges from idx[0] to
+ *  idx[nidx-1]. Virtual edges are added from nodes with excess
+ *  in-degree to nodes with excess out-degree to balance the graph; an
+ *  Euler circuit of each component is then split at the virtual edges,
+ *  giving the minimum number of trails that cover all the scenarios.
+ *
+ *------------------------------------------------------------------------
+ */
+void Cell::_schedule_scenarios ()
+{
+  int nedges = A_LEN (dscen);
+  int nv;
+  int *vtx;
+  int *from, *to;
+  int *bal;
+  int nvirt;
+
+  if (nedges < 2) {
+    return;
+  }
+
+  /*-- map input vectors to node numbers --*/
+  MALLOC (vtx, int, 2*nedges);
+  for (int i=0; i < nedges; i++) {
+    vtx[2*i] = dscen[i].idx[0];
+    vtx[2*i+1] = dscen[i].idx[dscen[i].nidx-1];
+  }
+  qsort (vtx, 2*nedges, sizeof (int), _int_cmp);
+  nv = 0;
+  for (int i=0; i < 2*nedges; i++) {
+    if (nv == 0 || vtx[nv-1] != vtx[i]) {
+      vtx[nv++] = vtx[i];
+    }
+  }
+
+  /*-- edges: real ones first, then virtual ones --*/
+  MALLOC (from, int, 2*nedges);
+  MALLOC (to, int, 2*nedges);
+  MALLOC (bal, int, nv);
+  for (int i=0; i < nv; i++) {
+    bal[i] = 0;
+  }
+  for (int i=0; i < nedges; i++) {
+    int *x;
+    x = (int *) bsearch (&dscen[i].idx[0], vtx, nv, sizeof (int), _int_cmp);
+    Assert (x, "What?");
+    from[i] = x - vtx;
+    x = (int *) bsearch (&dscen[i].idx[dscen[i].nidx-1], vtx, nv,
+			 sizeof (int), _int_cmp);
+    Assert (x, "What?");
+    to[i] = x - vtx;
+    bal[from[i]]++;
+    bal[to[i]]--;
+  }
+
+  nvirt = 0;
+  {
+    int u = 0, v = 0;
+    while (1) {
+      /* u: more edges in than out; v: more out than in */
+      while (u < nv && bal[u] >= 0) u++;
+      while (v < nv && bal[v] <= 0) v++;
+      if (u == nv || v == nv) break;
+      from[nedges + nvirt] = u;
+      to[nedges + nvirt] = v;
+      bal[u]++;
+      bal[v]--;
+      nvirt++;
+    }
+  }
+
+  /*-- adjacency lists --*/
+  int *head, *next, *used;
+  int tot = nedges + nvirt;
+
+  MALLOC (head, int, nv);
+  MALLOC (next, int, tot);
+  MALLOC (used, int, tot);
+  for (int i=0; i < nv; i++) {
+    head[i] = -1;
+  }
+  for (int i=tot-1; i >= 0; i--) {
+    next[i] = head[from[i]];
+    head[from[i]] = i;
+    used[i] = 0;
+  }
+
+  /*-- Hierholzer: find circuits, and split them at virtual edges --*/
+  int *order, norder;
+  int *circ, ncirc;
+  int *stk_v, *stk_e, nstk;
+
+  MALLOC (order, int, nedges);
+  MALLOC (circ, int, tot);
+  MALLOC (stk_v, int, tot + 1);
+  MALLOC (stk_e, int, tot + 1);
+  norder = 0;
+
+  for (int st=0; st < nv; st++) {
+    if (head[st] == -1) continue;
+
+    ncirc = 0;
+    nstk = 0;
+    stk_v[nstk] = st;
+    stk_e[nstk] = -1;
+    nstk++;
+    while (nstk > 0) {
+      int v = stk_v[nstk-1];
+      while (head[v] != -1 && used[head[v]]) {
+	head[v] = next[head[v]];
+      }
+      if (head[v] != -1) {
+	int e = head[v];
+	used[e] = 1;
+	stk_v[nstk] = to[e];
+	stk_e[nstk] = e;
+	nstk++;
+      }
+      else {
+	nstk--;
+	if (stk_e[nstk] != -1) {
+	  circ[ncirc++] = stk_e[nstk];
+	}
+      }
+    }
+    if (ncirc == 0) continue;
+
+    /* circ[] is the circuit in reverse order; rotate it to start just
+       after a virtual edge, if there is one */
+    int rot = 0;
+    for (int i=0; i < ncirc; i++) {
+      if (circ[i] >= nedges) {
+	rot = i;
+	break;
+      }
+    }
+    int first = 1;
+    for (int i=0; i < ncirc; i++) {
+      int e = circ[(rot + ncirc - 1 - i) % ncirc];
+      if (e >= nedges) {
+	first = 1;
+	continue;
+      }
+      /* a user-specified scenario may need its own idx[0] step, so
+	 only generated ones rely on their predecessor */
+      dscen[e].skip = (first || dscen[e].user) ? 0 : 1;
+      order[norder++] = e;
+      first = 0;
+    }
+  }
+  Assert (norder == nedges, "Scenario schedule is incomplete?");
+
+  /*-- reorder the scenarios --*/
+  struct dynamic_scenario *tmp;
+  int *map;
+  int nwin = 0, onwin = 0, ntrail = 0;
+
+  MALLOC (tmp, struct dynamic_scenario, nedges);
+  MALLOC (map, int, nedges);
+  for (int i=0; i < nedges; i++) {
+    tmp[i] = dscen[order[i]];
+    map[order[i]] = i;
+    nwin += tmp[i].nidx - tmp[i].skip;
+    onwin += tmp[i].nidx;
+  }
+  for (int i=0; i < nedges; i++) {
+    dscen[i] = tmp[i];
+  }
+  for (int i=0; i < A_LEN (dyn); i++) {
+    dyn[i].scen = map[dyn[i].scen];
+  }
+  dscen[0].skip = 0;
+  for (int i=0; i < nedges; i++) {
+    if (dscen[i].skip == 0) {
+      ntrail++;
+    }
+  }
+
+  if (verbose) {
+    printf (" scenario schedule: %d windows (was %d), %d trail(s)\n",
+	    nwin, onwin, ntrail);
+  }
+
+  FREE (tmp);
+  FREE (map);
+  FREE (order);
+  FREE (circ);
+  FREE (stk_v);
+  FREE (stk_e);
+  FREE (head);
+  FREE (next);
+  FREE (used);
+  FREE (bal);
+  FREE (from);
+  FREE (to);
+  FREE (vtx);
+}
+
 /*------------------------------------------------------------------------
  *
  * Dynamic scenarios
  *
  *------------------------------------------------------------------------
  */
-int Cell::_run_dynamic ()
+/*
+  All the arc tables of a cell live in one block, structure of arrays:
+  the delay tables of every arc, then the transition tables, then the
+  internal power tables, each npts long and zeroed. dyn[i].delay,
+  .transit and .intpow point into the block.
+*/
+double *Cell::_alloc_arc_tables (int npts)
 {
-  FILE *sfp;
-  char buf[1024];
-  char file[1024];
+  double *tab;
+  int n = 3*A_LEN (dyn)*npts;
+
+  MALLOC (tab, double, n > 0 ? n : 1);
+  memset (tab, 0, sizeof (double)*n);
+  _bind_arc_tables (tab, npts);
+  return tab;
+}
+
+void Cell::_bind_arc_tables (double *tab, int npts)
+{
+  int n = A_LEN (dyn);
+  
+  for (int i=0; i < n; i++) {
+    dyn[i].delay = tab + i*npts;
+    dyn[i].transit = tab + (n + i)*npts;
+    dyn[i].intpow = tab + (2*n + i)*npts;
+  }
+}
 
+
+int Cell::_run_dynamic ()
+{
   if (!nl) {
     return 0;
   }
@@ -2029,61 +3354,305 @@ int Cell::_run_dynamic ()
   }
   
   _calc_dynamic ();
+  _calc_scenarios ();
+
+  if (A_LEN (dyn) == 0) {
+    warning ("Cell characterization failed; no arcs detected?");
+    return 0;
+  }
+
+  /*-- allocate space for dynamic measurements --*/
+  int nslew = config_get_table_size ("xcell.input_trans");
+  int nsweep = config_get_table_size ("xcell.load");
+
+  _arc_tab = _alloc_arc_tables (nsweep*nslew);
+  for (int i=0; i < A_LEN (dyn); i++) {
+    dyn[i].mc = NULL;
+    dyn[i].ccs = NULL;
+  }
+
+  if (!_sim_dynamic ("_spdy_", config_get_string ("xcell.accuracy"), 0, NULL)) {
+    return 0;
+  }
+
+  /*-- the nominal deck is all the cell needs; a failure in any of
+    these passes is only a warning --*/
+  if (config_get_int ("xcell.repair.enable")) {
+    prof_begin (NULL, "repair");
+    _optional = "repair";
+    _opt_failed = 0;
+    _repair_dynamic ();
+    prof_end ();
+  }
+  if (config_get_int ("xcell.validate") > 0) {
+    prof_begin (NULL, "validate");
+    _optional = "validation";
+    _opt_failed = 0;
+    _validate_dynamic ();
+    prof_end ();
+  }
+  if (config_get_int ("xcell.mc.samples") > 1) {
+    prof_begin (NULL, "mc");
+    _optional = "Monte Carlo";
+    _opt_failed = 0;
+    _run_mc ();
+    prof_end ();
+  }
+  _optional = NULL;
+  if (config_get_int ("xcell.ccs.enable")) {
+    prof_begin (NULL, "ccs");
+    _run_ccs ();
+    prof_end ();
+  }
+  return 1;
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Simulate dynamic scenarios and fill in the delay, transit, and
+ *  internal power tables of the arcs they measure.
+ *
+ *    tag    : deck file prefix
+ *    preset : simulator accuracy preset (xcell.preset.<name>)
+ *    nsel, sel : if sel is non-NULL, only simulate scenarios
+ *                sel[0..nsel-1]; otherwise all of them.
+ *
+ *------------------------------------------------------------------------
+ */
+int Cell::_sim_dynamic (const char *tag, const char *preset,
+			int nsel, int *sel)
+{
+  char buf[1024];
+  char file[1024];
+
+  snprintf (file, 1024, "%s", tag);
+  a->msnprintfproc (file + strlen (file), 1024 - strlen (file), _p);
+
+  prof_begin (NULL, "deck");
+  if (!_write_dynamic (file, preset, nsel, sel, 0, 0)) {
+    prof_end ();
+    return 0;
+  }
+  prof_end ();
+
+  snprintf (buf, 1024, "%s %s.spi > %s.log 2>&1",
+	    config_get_string ("xcell.spice_binary"), file, file);
+  if (prof_system ("sim", buf, _sim_limit) == JOBS_TIMEOUT) {
+    return _sim_dynamic_timeout (tag, preset, nsel, sel, file);
+  }
+
+  return _read_dynamic (file, nsel, sel, 0);
+}
+
+
+/*
+  The deck <file>.spi of _sim_dynamic was killed by the watchdog. A
+  deck with several scenarios is split in two halves, each simulated
+  (and split again, if need be) on its own; the halves are shorter and
+  so is their limit, and a scenario that hangs the simulator ends up
+  alone. A single scenario is simulated again with each preset of
+  xcell.watchdog.retry in turn (default: robust).
+*/
+int Cell::_sim_dynamic_timeout (const char *tag, const char *preset,
+				int nsel, int *sel, const char *file)
+{
+  char buf[1024];
+  char spi[1024];
+  double limit = _sim_limit;
+  int nsc = sel ? nsel : A_LEN (dscen);
+  int only = 0;
+
+  snprintf (spi, 1024, "%s.spi", file);
+  if (nsc > 1) {
+    int *all = NULL;
+    int h = nsc/2;
+    int ok;
     
-  /* -- create spice file -- */
+    snprintf (buf, 1024, "split into %d + %d scenarios", h, nsc - h);
+    wd_timeout (spi, limit, buf);
+    unlink_killed (file, config_get_table_size ("xcell.load"));
+    if (!sel) {
+      MALLOC (all, int, nsc);
+      for (int j=0; j < nsc; j++) {
+	all[j] = j;
+      }
+      sel = all;
+    }
+    snprintf (buf, 1024, "%s0_", tag);
+    ok = _sim_dynamic (buf, preset, h, sel);
+    if (ok) {
+      snprintf (buf, 1024, "%s1_", tag);
+      ok = _sim_dynamic (buf, preset, nsc - h, sel + h);
+    }
+    if (all) {
+      FREE (all);
+    }
+    return ok;
+  }
 
-  snprintf (file, 1024, "_spdy_");
-  a->msnprintfproc (file + 6, 1018, _p);
+  int nretry;
+  char **retry;
+  const char *robust = "robust";
+
+  if (!sel) {
+    /* -- the cell has a single scenario -- */
+    nsel = 1;
+    sel = &only;
+  }
   
+  if (config_exists ("xcell.watchdog.retry")) {
+    nretry = config_get_table_size ("xcell.watchdog.retry");
+    retry = config_get_table_string ("xcell.watchdog.retry");
+  }
+  else {
+    nretry = 1;
+    retry = (char **) &robust;
+  }
+  for (int k=0; k < nretry; k++) {
+    if (strcmp (retry[k], preset) == 0) continue;
+    
+    snprintf (buf, 1024, "retry scenario %d with preset `%s'",
+	      sel[0], retry[k]);
+    wd_timeout (spi, limit, buf);
+    unlink_killed (file, config_get_table_size ("xcell.load"));
+    if (!_write_dynamic (file, retry[k], nsel, sel, 0, 0)) {
+      return 0;
+    }
+    limit = _sim_limit;
+    snprintf (buf, 1024, "%s %s.spi > %s.log 2>&1",
+	      config_get_string ("xcell.spice_binary"), file, file);
+    if (prof_system ("sim", buf, limit) != JOBS_TIMEOUT) {
+      return _read_dynamic (file, nsel, sel, 0);
+    }
+  }
+  wd_timeout (spi, limit, "cell failed");
+  return _fail (file, "Scenario %d timed out with every preset", sel[0]);
+}
+
+
+/*
+  Write the deck for _sim_dynamic to <file>.spi. If nmc > 0, the load
+  sweep is replaced by a sweep over (load, sample) pairs for Monte
+  Carlo samples mcbase ... mcbase+nmc-1, row r being load r % nload
+  of sample mcbase + r / nload. If ccs_load >= 0, only that load is
+  simulated and the output waveforms are saved for _read_ccs, with the
+  start of every arc's window in _ccs_off[].
+*/
+int Cell::_write_dynamic (const char *file, const char *preset,
+			  int nsel, int *sel, int nmc, int mcbase,
+			  int ccs_load)
+{
+  FILE *sfp;
+  char buf[1024];
+
+  /*-- scl[] is the list of scenarios simulated, scpos[] its inverse --*/
+  int nsc = sel ? nsel : A_LEN (dscen);
+  int *scl, *scpos;
+
+  MALLOC (scl, int, nsc);
+  MALLOC (scpos, int, A_LEN (dscen));
+  for (int j=0; j < A_LEN (dscen); j++) {
+    scpos[j] = -1;
+  }
+  for (int j=0; j < nsc; j++) {
+    scl[j] = sel ? sel[j] : j;
+    scpos[scl[j]] = j;
+  }
+    
+  /* -- create spice file -- */
+
   snprintf (buf, 1024, "%s.spi", file);
   sfp = fopen (buf, "w");
   if (!sfp) {
-    fatal_error ("Could not open `%s' for writing", buf);
+    FREE (scl);
+    FREE (scpos);
+    return _fail (NULL, "Could not open `%s' for writing", buf);
   }
 
   /* -- std header that instantiates the module -- */
-  if (!_gen_spice_header (sfp)) {
+  if (!_gen_spice_header (sfp, ccs_load >= 0)) {
     fclose (sfp);
     unlink (buf);
+    FREE (scl);
+    FREE (scpos);
     return 0;
   }
+  print_sim_options (sfp, preset);
+  if (nmc > 0) {
+    fprintf (sfp, ".param %s = %d\n\n", config_get_string ("xcell.mc.param"),
+	     mcbase);
+  }
 
   /* emit waveform for each input */
   double window = config_get_real ("xcell.short_window");
   double vdd = config_get_real ("xcell.Vdd");
-  double period = config_get_real ("xcell.period");
   int nslew = config_get_table_size ("xcell.input_trans");
   double *slew_table = config_get_table_real ("xcell.input_trans");
   int tm;
 
-  if (A_LEN (dyn) == 0) {
-    warning ("Cell characterization failed; no arcs detected?");
-    fclose (sfp);
-    snprintf (buf, 1024, "%s.spi", file);
-    unlink (buf);
-    return 0;
+  /*-- plan the time slots: scenario scl[j] for slew ns uses slot
+    ns*nsc + j, and it is as long as its input sequence. skip[] is the
+    number of leading steps of the slot that are already in place when
+    it starts; chained scenarios rely on their predecessor, so they can
+    only skip steps when every scenario is simulated --*/
+  struct timeline tl;
+  double *slot;
+  int *skip;
+  int nslots = nslew*nsc;
+  int ic_ok;
+  struct dynamic_scenario *ds0 = &dscen[scl[0]];
+
+  /*-- the very first step can come from the initial conditions, as
+    long as every state-holding gate is driven in that state --*/
+  ic_ok = _print_initial_state (sfp, ds0->idx[0]);
+  timeline_init (&tl, ic_ok ? config_get_real ("xcell.ic_hold") : 1000);
+
+  MALLOC (slot, double, nslots + 1);
+  MALLOC (skip, int, nslots);
+  for (int ns=0; ns < nslew; ns++) {
+    for (int j=0; j < nsc; j++) {
+      skip[ns*nsc + j] = sel ? 0 : dscen[scl[j]].skip;
+    }
+  }
+  if (ic_ok && skip[0] == 0) {
+    skip[0] = 1;
   }
+  for (int i=0; i < nslots; i++) {
+    slot[i] = timeline_alloc (&tl, (dscen[scl[i % nsc]].nidx - skip[i])*window);
+  }
+  slot[nslots] = timeline_end (&tl);
 
   for (int i=0; i < _num_inputs; i++) {
-    fprintf (sfp, "Vn%d p%d 0 PWL (0p 0 1000p %g\n", _get_input_pin (i),
-	     _get_input_pin (i),
-	     ((dyn[0].idx[0] >> i) & 1) ? vdd : 0.0);
+    double v0 = ((ds0->idx[0] >> i) & 1) ? vdd : 0.0;
+    fprintf (sfp, "Vn%d p%d 0 PWL (0p %g %gp %g\n", _get_input_pin (i),
+	     _get_input_pin (i), v0, slot[0], v0);
 
-    tm = 1;
+    tm = 0;
     /*-- this has to be done with different input slew --*/
     for (int ns=0; ns < nslew; ns++) {
-      for (int j=0; j < A_LEN (dyn); j++) {
-	for (int k=0; k < dyn[j].nidx; k++) {
-	  int ival = ((dyn[j].idx[k] >> i) & 1);
-	  double val = ((dyn[j].idx[k] >> i) & 1) ? vdd : 0.0;
-
-	  if (k != (dyn[j].nidx-1) || i != (dyn[j].in_id)) {
-	    print_window (sfp, tm*period + 0.25*window + k*window,
-			  tm*period + (k+1)*window, ival);
+      for (int jj=0; jj < nsc; jj++) {
+	int j = scl[jj];
+	for (int k=skip[tm]; k < dscen[j].nidx; k++) {
+	  int ival = ((dscen[j].idx[k] >> i) & 1);
+	  double val = ((dscen[j].idx[k] >> i) & 1) ? vdd : 0.0;
+	  double st = slot[tm] + (k - skip[tm])*window;
+	  double end;
+
+	  /* the last step holds its value through the settle margin */
+	  if (k == dscen[j].nidx-1) {
+	    end = slot[tm+1];
+	  }
+	  else {
+	    end = st + window;
+	  }
+
+	  if (k != (dscen[j].nidx-1) || i != (dscen[j].in_id)) {
+	    print_window (sfp, st + 0.25*window, end, ival);
 	  }
 	  else {
 	    double correction = 0.0;
-	    if (dyn[j].in_init == 0) {
+	    if (dscen[j].in_init == 0) {
 	      correction = (config_get_real ("xcell.waveform.rise_high") -
 			    config_get_real ("xcell.waveform.rise_low"))/100.0;
 	    }
@@ -2091,8 +3660,7 @@ int Cell::_run_dynamic ()
 	      correction = (config_get_real ("xcell.waveform.fall_high") -
 			    config_get_real ("xcell.waveform.fall_low"))/100.0;
 	    }
-	    print_window (sfp, tm*period + k*window + slew_table[ns]/correction,
-			  tm*period + (k+1)*window, ival);
+	    print_window (sfp, st + slew_table[ns]/correction, end, ival);
 
 	    if (slew_table[ns]/correction >= window) {
 	      warning ("Window is too small; needs to be at least %g\n",
@@ -2106,9 +3674,48 @@ int Cell::_run_dynamic ()
     fprintf (sfp, "+)\n\n");
   }
 
-  fprintf (sfp, "\n.tran 0.1p ");
-  print_number (sfp, 1e-12*tm*period);
-  if (is_xyce()) {
+  fprintf (sfp, "\n");
+  print_tran (sfp, preset, timeline_end (&tl));
+  if (nmc > 0) {
+    print_mc_sweep (sfp, nmc, mcbase);
+  }
+  else if (ccs_load >= 0) {
+    double *load_table = config_get_table_real ("xcell.load");
+    if (is_xyce()) {
+      fprintf (sfp, "\n.step load LIST %gf\n", load_table[ccs_load]);
+
+      /*-- full resolution output only inside the arc windows --*/
+      double fine = preset_real (preset, "tstep");
+      double wend = -1;
+      fprintf (sfp, ".options output initial_interval=%gp", window);
+      for (int i=0; i < nslots; i++) {
+	double off = slot[i] +
+	  (dscen[scl[i % nsc]].nidx-1-skip[i])*window;
+	if (off != wend) {
+	  if (wend >= 0) {
+	    fprintf (sfp, "\n+ %gp %gp", wend, window);
+	  }
+	  fprintf (sfp, "\n+ %gp %gp", off, fine);
+	}
+	wend = off + window;
+      }
+      fprintf (sfp, "\n+ %gp %gp\n", wend, window);
+      fprintf (sfp, ".print tran format=raw");
+    }
+    else {
+      fprintf (sfp, " SWEEP load POI 1 %gf\n", load_table[ccs_load]);
+      fprintf (sfp, ".options post post_version=9601\n");
+      fprintf (sfp, ".print tran");
+    }
+    for (int i=0; i < _num_outputs; i++) {
+      fprintf (sfp, " V(cc%d)", _get_output_pin (i));
+    }
+    fprintf (sfp, "\n\n");
+    if (is_hspice()) {
+      fprintf (sfp, ".options measform=2\n");
+    }
+  }
+  else if (is_xyce()) {
     fprintf (sfp, "\n");
 #if 0
     fprintf (sfp, "\n.print tran");
@@ -2139,29 +3746,18 @@ int Cell::_run_dynamic ()
     fatal_error ("What?");
   }
 
-  /*-- allocate space for dynamic measurements --*/
-
-  int nsweep = config_get_table_size ("xcell.load");
-
-  for (int i=0; i < A_LEN (dyn); i++) {
-    MALLOC (dyn[i].delay, double, nsweep*nslew);
-    MALLOC (dyn[i].transit, double, nsweep*nslew);
-    MALLOC (dyn[i].intpow, double, nsweep*nslew);
-    for (int j=0; j < nsweep*nslew; j++) {
-      dyn[i].delay[j] = 0;
-      dyn[i].transit[j] = 0;
-      dyn[i].intpow[j] = 0;
-    }
-  }
-
   /* measure output transit time and delay */
     
   /*-- this has to be done with different input slew --*/
-  tm = 1;
   for (int ns=0; ns < nslew; ns++) {
+    tm = ns*nsc;
     for (int j=0; j < A_LEN (dyn); j++) {
-      int k = dyn[j].nidx-1;
-      double off = tm*period + k*window;
+      if (scpos[dyn[j].scen] == -1) continue;
+      int k = dyn[j].nidx-1 - skip[tm + scpos[dyn[j].scen]];
+      double off = slot[tm + scpos[dyn[j].scen]] + k*window;
+      if (ccs_load >= 0) {
+	_ccs_off[j*nslew + ns] = off;
+      }
       double st, end;
 
       /* 
@@ -2188,34 +3784,102 @@ int Cell::_run_dynamic ()
 	       dyn[j].out_id, dyn[j].out_init ? "fall" : "rise");
       fprintf (sfp, ".measure tran transit_%d_%d trig V(p%d) VAL=%g TD=%gp CROSS=1 targ V(p%d) VAL=%g\n", j, ns, _get_output_pin (dyn[j].out_id), st, off,
 	       _get_output_pin (dyn[j].out_id), end);
-      
-      /*
-	3. Measure internal power
-      */
+    }
+
+    /*
+      3. Measure internal power
+    */
+    for (int j=0; j < nsc; j++) {
+      double off = slot[tm + j] + (dscen[scl[j]].nidx-1-skip[tm + j])*window;
       fprintf (sfp, ".measure tran intpow_%d_%d avg i(Vv1) from %gp to %gp\n",
-	       j, ns, off, off + window);
-      tm++;
+	       scl[j], ns, off, off + window);
+    }
+  }
+
+  int narcs = 0;
+  for (int j=0; j < A_LEN (dyn); j++) {
+    if (scpos[dyn[j].scen] != -1) {
+      narcs++;
     }
   }
 
+  FREE (slot);
+  FREE (skip);
+  FREE (scl);
+  FREE (scpos);
+
   fprintf (sfp, "\n.end\n");
   fclose (sfp);
 
-  snprintf (buf, 1024, "%s %s.spi > %s.log 2>&1",
-	    config_get_string ("xcell.spice_binary"), file, file);
-  system (buf);
+  snprintf (buf, 1024, "%s.spi", file);
+  prof_deck (buf, timeline_end (&tl), narcs);
+  _sim_limit = wd_limit (buf, timeline_end (&tl),
+			 nmc > 0 ? nmc*config_get_table_size ("xcell.load") :
+			 (ccs_load >= 0 ? 1 : config_get_table_size ("xcell.load")));
+
+  return 1;
+}
+
+
+/*
+  Read the measurements of a deck written by _write_dynamic. If nmc >
+  0, every sample is added to the Monte Carlo sums of the arcs instead
+  (see _run_mc); the delay/transit tables are then used as scratch
+  space.
+*/
+int Cell::_read_dynamic (const char *file, int nsel, int *sel, int nmc)
+{
+  char buf[1024];
+  double window = config_get_real ("xcell.short_window");
+  double vdd = config_get_real ("xcell.Vdd");
+  int nslew = config_get_table_size ("xcell.input_trans");
+  int nsweep = config_get_table_size ("xcell.load");
+  int nrows = nmc > 0 ? nmc*nsweep : nsweep;
+  int *scpos;
+
+  MALLOC (scpos, int, A_LEN (dscen));
+  for (int j=0; j < A_LEN (dscen); j++) {
+    scpos[j] = sel ? -1 : j;
+  }
+  for (int j=0; sel && j < nsel; j++) {
+    scpos[sel[j]] = j;
+  }
+
+  /*-- clear the entries this run measures --*/
+  if (!sel) {
+    memset (_arc_tab, 0, sizeof (double)*3*A_LEN (dyn)*nsweep*nslew);
+  }
+  else {
+    for (int i=0; i < A_LEN (dyn); i++) {
+      if (scpos[dyn[i].scen] == -1) continue;
+      for (int j=0; j < nsweep*nslew; j++) {
+	dyn[i].delay[j] = 0;
+	dyn[i].transit[j] = 0;
+	dyn[i].intpow[j] = 0;
+      }
+    }
+  }
+
+  /*-- internal power is measured once per scenario, and then split
+    between all the arcs measured in the scenario --*/
+  double *scen_pow;
+  MALLOC (scen_pow, double, A_LEN (dscen)*nsweep*nslew);
+  for (int j=0; j < A_LEN (dscen)*nsweep*nslew; j++) {
+    scen_pow[j] = 0;
+  }
 
   double win = window*config_get_real ("xcell.units.time_conv");
   
   /* -- open measurements, and save data -- */
   int weird_error = 0;
-  for (int nload=0; nload < nsweep; nload++) {
+  for (int row=0; row < nrows; row++) {
     struct Hashtable *H;
     hash_bucket_t *b;
     hash_iter_t hi;
+    int nload = row % nsweep;
     
     if (is_xyce()) {
-      snprintf (buf, 1024, "%s.spi.mt%d", file, nload);
+      snprintf (buf, 1024, "%s.spi.mt%d", file, row);
     }
     else {
       snprintf (buf, 1024, "%s.mt0", file);
@@ -2225,10 +3889,12 @@ int Cell::_run_dynamic ()
       H = parse_measurements (buf);
     }
     else {
-      H = parse_measurements (buf, "load", nload);
+      H = parse_measurements (buf, "load", row);
     }
     if (!H) {
-      fatal_error ("Could not open measurement output file %s.\n", buf);
+      FREE (scen_pow);
+      FREE (scpos);
+      return _fail (file, "Could not open measurement output file %s", buf);
     }
 
     hash_iter_init (H, &hi);
@@ -2258,11 +3924,14 @@ int Cell::_run_dynamic ()
 	continue;
       }
       if (sscanf (s + off, "%d_%d", &i, &j) != 2) {
-	fatal_error ("Could not parse line: %s", buf);
+	hash_free (H);
+	FREE (scen_pow);
+	FREE (scpos);
+	return _fail (file, "Unknown measurement `%s'", s);
       }
       v = b->f;
       
-      Assert (0 <= i && i < A_LEN (dyn), "What?");
+      Assert (0 <= i && i < (type == 2 ? A_LEN (dscen) : A_LEN (dyn)), "What?");
       Assert (0 <= j && j < nslew, "What?");
 
       if (v == -1) {
@@ -2299,31 +3968,1508 @@ int Cell::_run_dynamic ()
 	dyn[i].transit[j+nload*nslew] = v;
       }
       else if (type == 2) {
-	dyn[i].intpow[j+nload*nslew] = -v*vdd;
+	scen_pow[i*nsweep*nslew + j+nload*nslew] = -v*vdd;
       }
     }
     hash_free (H);
+
+    if (nmc > 0) {
+      /*-- add this sample to the sums; a sample only counts if the
+	output transition was measured --*/
+      for (int i=0; i < A_LEN (dyn); i++) {
+	if (scpos[dyn[i].scen] == -1) continue;
+	for (int j=0; j < nslew; j++) {
+	  int k = j + nload*nslew;
+	  double *mc = &dyn[i].mc[5*k];
+	  if (dyn[i].transit[k] > 0) {
+	    mc[0] += 1;
+	    mc[1] += dyn[i].delay[k];
+	    mc[2] += dyn[i].delay[k]*dyn[i].delay[k];
+	    mc[3] += dyn[i].transit[k];
+	    mc[4] += dyn[i].transit[k]*dyn[i].transit[k];
+	  }
+	  dyn[i].delay[k] = 0;
+	  dyn[i].transit[k] = 0;
+	}
+      }
+    }
+  }
+
+  for (int i=0; nmc == 0 && i < A_LEN (dyn); i++) {
+    struct dynamic_scenario *ds = &dscen[dyn[i].scen];
+    if (scpos[dyn[i].scen] == -1) continue;
+    for (int j=0; j < nsweep*nslew; j++) {
+      dyn[i].intpow[j] = scen_pow[dyn[i].scen*nsweep*nslew + j]/ds->narcs;
+    }
+  }
+  FREE (scen_pow);
+  FREE (scpos);
+
+  if (!weird_error) {
+    unlink_generic (file);
+  }
+
+  /* Xyce creates multiple measurement files */
+  if (!weird_error && is_xyce()) {
+    /* -- other measurement files -- */
+    for (int i=1; i < nrows; i++) {
+      snprintf (buf, 1024, "%s.spi.mt%d", file, i);
+      unlink (buf);
+    }
+    snprintf (buf, 1024, "%s.spi.res", file);
+    unlink (buf);
+  }
+  return 1;
+}
+
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Statistical (LVF) characterization: simulate up to xcell.mc.samples
+ *  Monte Carlo samples of every dynamic arc. Sample s is selected by
+ *  setting the spice parameter xcell.mc.param to s; the technology
+ *  setup file is expected to map it to device variation.
+ *
+ *  A round simulates max(xcell.mc.batch, xcell.mc.min_samples)
+ *  samples, spread evenly over up to xcell.jobs decks (simulator
+ *  runs) of at most xcell.mc.batch samples each, all in parallel.
+ *  Sampling stops once at least xcell.mc.min_samples were simulated
+ *  and no sigma estimate moved by more than xcell.mc.tol percent over
+ *  the last round.
+ *
+ *------------------------------------------------------------------------
+ */
+void Cell::_run_mc ()
+{
+  int nslew = config_get_table_size ("xcell.input_trans");
+  int nsweep = config_get_table_size ("xcell.load");
+  int npts = nslew*nsweep;
+  int nmax = config_get_int ("xcell.mc.samples");
+  int batch = config_get_int ("xcell.mc.batch");
+  int nmin = config_get_int ("xcell.mc.min_samples");
+  double tol = config_get_real ("xcell.mc.tol")/100.0;
+  const char *preset = config_get_string ("xcell.accuracy");
+  int njobs = jobs_max ();
+  double *save;
+  double *prev;
+  int *cnt;
+  int *ids;			/* job of each deck in a round */
+  double *lim;			/* and its watchdog limit */
+  int done = 0;			/* samples simulated */
+  int next = 0;			/* first sample of the next deck */
+  int rounds = 0;
+  double change = 0;
+  char buf[1024];
+  char file[1024];
+
+  if (batch < 1) {
+    batch = 1;
+  }
+  int round = (nmin > batch) ? nmin : batch;
+
+  /*-- the nominal results are kept; the samples are read into fresh
+    tables --*/
+  save = _arc_tab;
+  _arc_tab = _alloc_arc_tables (npts);
+  for (int i=0; i < A_LEN (dyn); i++) {
+    MALLOC (dyn[i].mc, double, 5*npts);
+    for (int j=0; j < 5*npts; j++) {
+      dyn[i].mc[j] = 0;
+    }
+  }
+  MALLOC (prev, double, 2*npts*A_LEN (dyn));
+  for (int j=0; j < 2*npts*A_LEN (dyn); j++) {
+    prev[j] = -1;
+  }
+  MALLOC (cnt, int, njobs);
+  MALLOC (ids, int, njobs);
+  MALLOC (lim, double, njobs);
+
+  struct job_pool *jp = jobs_new (njobs);
+  while (done < nmax) {
+    int ndeck = 0;
+    int pend = 0;
+    int ndrop = 0;
+    int todo = (nmax - done < round) ? (nmax - done) : round;
+    int per = (todo + njobs - 1)/njobs;
+
+    if (per > batch) {
+      per = batch;
+    }
+    for (int b=0; b < njobs && pend < todo; b++) {
+      cnt[b] = (todo - pend < per) ? (todo - pend) : per;
+      snprintf (file, 1024, "_spmc%d_", b);
+      a->msnprintfproc (file + strlen (file), 1024 - strlen (file), _p);
+      if (!_write_dynamic (file, preset, 0, NULL, cnt[b], next)) {
+	break;
+      }
+      snprintf (buf, 1024, "%s %s.spi > %s.log 2>&1",
+		config_get_string ("xcell.spice_binary"), file, file);
+      lim[b] = _sim_limit;
+      ids[b] = jobs_submit_limit (jp, buf, lim[b]);
+      next += cnt[b];
+      pend += cnt[b];
+      ndeck++;
+    }
+    prof_begin (NULL, "sim");
+    jobs_wait (jp);
+    prof_end ();
+    if (ndeck == 0) {
+      break;
+    }
+    for (int b=0; b < ndeck; b++) {
+      snprintf (file, 1024, "_spmc%d_", b);
+      a->msnprintfproc (file + strlen (file), 1024 - strlen (file), _p);
+      if (jobs_status (jp, ids[b]) == JOBS_TIMEOUT) {
+	/*-- these samples are not counted; later decks use new ones --*/
+	snprintf (buf, 1024, "%s.spi", file);
+	wd_timeout (buf, lim[b], "Monte Carlo samples dropped");
+	unlink_killed (file, cnt[b]*config_get_table_size ("xcell.load"));
+	ndrop++;
+	continue;
+      }
+      if (!_read_dynamic (file, 0, NULL, cnt[b])) {
+	break;
+      }
+      done += cnt[b];
+    }
+    if (ndeck > 0 && ndrop == ndeck) {
+      warning ("%s: every Monte Carlo deck of a round timed out; "
+	       "stopping at %d samples", _p->getName(), done);
+      break;
+    }
+    if (_opt_failed) {
+      break;
+    }
+    rounds++;
+
+    /*-- largest relative change of any sigma in this round --*/
+    change = 0;
+    for (int i=0; i < A_LEN (dyn); i++) {
+      for (int j=0; j < npts; j++) {
+	for (int w=0; w < 2; w++) {
+	  double sig = mc_sigma (&dyn[i].mc[5*j], w);
+	  double *p = &prev[2*(i*npts + j) + w];
+	  if (sig > 0) {
+	    if (*p < 0) {
+	      change = 1;
+	    }
+	    else if (fabs (sig - *p)/sig > change) {
+	      change = fabs (sig - *p)/sig;
+	    }
+	  }
+	  *p = sig;
+	}
+      }
+    }
+    if (done >= nmin && change <= tol) {
+      break;
+    }
+  }
+  jobs_free (jp);
+
+  if (_opt_failed) {
+    /*-- no statistics from an incomplete run --*/
+    for (int i=0; i < A_LEN (dyn); i++) {
+      FREE (dyn[i].mc);
+      dyn[i].mc = NULL;
+    }
+  }
+  else {
+    printf ("  Monte Carlo: %d samples in %d rounds (sigma change %.3g%%)\n",
+	    done, rounds, change*100);
+  }
+
+  FREE (_arc_tab);
+  _arc_tab = save;
+  _bind_arc_tables (_arc_tab, npts);
+  FREE (prev);
+  FREE (cnt);
+  FREE (ids);
+  FREE (lim);
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  CCS output current waveforms. Every load gets its own deck (the
+ *  dynamic deck with a single load, saving the current through a 0V
+ *  source in series with each load), and the decks run in parallel. The traces are read back one arc window
+ *  at a time, so memory use only depends on the window length.
+ *
+ *------------------------------------------------------------------------
+ */
+void Cell::_run_ccs ()
+{
+  int nslew = config_get_table_size ("xcell.input_trans");
+  int nsweep = config_get_table_size ("xcell.load");
+  const char *preset = config_get_string ("xcell.accuracy");
+  char buf[2048];
+  char file[1024];
+  int nrun = 0;
+
+  MALLOC (_ccs_off, double, A_LEN (dyn)*nslew);
+  for (int i=0; i < A_LEN (dyn); i++) {
+    MALLOC (dyn[i].ccs, struct ccs_wave, nslew*nsweep);
+    for (int j=0; j < nslew*nsweep; j++) {
+      dyn[i].ccs[j].n = 0;
+      dyn[i].ccs[j].t = NULL;
+      dyn[i].ccs[j].i = NULL;
+    }
+  }
+
+  int *ids;
+  double *lim;
+  MALLOC (ids, int, nsweep);
+  MALLOC (lim, double, nsweep);
+
+  struct job_pool *jp = jobs_new (jobs_max ());
+  for (int nload=0; nload < nsweep; nload++) {
+    snprintf (file, 1024, "_spcc%d_", nload);
+    a->msnprintfproc (file + strlen (file), 1024 - strlen (file), _p);
+    if (!_write_dynamic (file, preset, 0, NULL, 0, 0, nload)) {
+      break;
+    }
+    /* -- convert the trace as part of the job -- */
+    if (config_get_int ("xcell.spice_output_fmt") == 0) {
+      snprintf (buf, 2048, "%s %s.spi > %s.log 2>&1; tr2alint -r %s.spi.raw %s",
+		config_get_string ("xcell.spice_binary"), file, file,
+		file, file);
+    }
+    else {
+      snprintf (buf, 2048, "%s %s.spi > %s.log 2>&1; tr2alint %s.tr0 %s",
+		config_get_string ("xcell.spice_binary"), file, file,
+		file, file);
+    }
+    lim[nload] = _sim_limit;
+    ids[nload] = jobs_submit_limit (jp, buf, lim[nload]);
+    nrun++;
+  }
+  prof_begin (NULL, "sim");
+  jobs_wait (jp);
+  prof_end ();
+  for (int nload=0; nload < nrun; nload++) {
+    ids[nload] = jobs_status (jp, ids[nload]);
+  }
+  jobs_free (jp);
+
+  for (int nload=0; nload < nrun; nload++) {
+    snprintf (file, 1024, "_spcc%d_", nload);
+    a->msnprintfproc (file + strlen (file), 1024 - strlen (file), _p);
+    if (ids[nload] == JOBS_TIMEOUT) {
+      snprintf (buf, 2048, "%s.spi", file);
+      wd_timeout (buf, lim[nload], "no CCS waveforms for this load");
+      unlink_killed (file, 1);
+      continue;
+    }
+    _read_ccs (file, nload);
+    unlink_generic_trace (file);
+  }
+  FREE (ids);
+  FREE (lim);
+  FREE (_ccs_off);
+  _ccs_off = NULL;
+}
+
+
+/*
+  Read the load currents of CCS deck file (load index nload), reduced
+  to at most xcell.ccs.points points per waveform.
+*/
+void Cell::_read_ccs (const char *file, int nload)
+{
+  int nslew = config_get_table_size ("xcell.input_trans");
+  double *slew_table = config_get_table_real ("xcell.input_trans");
+  double window = config_get_real ("xcell.short_window");
+  int maxpts = config_get_int ("xcell.ccs.points");
+  double tol = config_get_real ("xcell.ccs.tol")/100.0;
+  char buf[1024];
+
+  atrace *tr = atrace_open (file);
+  if (!tr) {
+    warning ("%s: could not open CCS trace `%s'", _p->getName(), file);
+    return;
+  }
+
+  name_t **outnode;
+  MALLOC (outnode, name_t *, _num_outputs);
+  for (int o=0; o < _num_outputs; o++) {
+    snprintf (buf, 1024, "cc%d", _get_output_pin (o));
+    outnode[o] = atrace_lookup (tr, buf);
+    if (!outnode[o]) {
+      warning ("%s: output `%s' not in CCS trace", _p->getName(), buf);
+      FREE (outnode);
+      atrace_close (tr);
+      return;
+    }
+  }
+
+  int nnodes, nsteps, fmt, ts;
+  if (atrace_header (tr, &ts, &nnodes, &nsteps, &fmt)) {
+    warning ("%s: corrupt CCS trace header", _p->getName());
+    FREE (outnode);
+    atrace_close (tr);
+    return;
+  }
+  double step = ATRACE_GET_STEPSIZE (tr);
+  int nwin = window*1e-12/step + 1;
+  if (nwin < 2) {
+    nwin = 2;
+  }
+
+  /*-- one window of every output at a time --*/
+  double *v, *t, *y;
+  int *sel;
+  MALLOC (v, double, nwin*_num_outputs);
+  MALLOC (t, double, nwin);
+  MALLOC (y, double, nwin);
+  MALLOC (sel, int, nwin);
+
+  /*-- arc windows in time order; arcs of the same scenario share a
+    window --*/
+  int narc = A_LEN (dyn)*nslew;
+  int *order;
+  MALLOC (order, int, narc);
+  for (int x=0; x < narc; x++) {
+    int pos = x;
+    while (pos > 0 && _ccs_off[order[pos-1]] > _ccs_off[x]) {
+      order[pos] = order[pos-1];
+      pos--;
+    }
+    order[pos] = x;
+  }
+
+  int cur = 0;
+  int last = -1;
+  atrace_init_time (tr);
+  for (int x=0; x < narc; x++) {
+    int j = order[x] / nslew;
+    int ns = order[x] % nslew;
+    int start = _ccs_off[order[x]]*1e-12/step;
+    int o = dyn[j].out_id;
+
+    if (start != last) {
+      if (start < cur) {
+	warning ("%s: overlapping CCS windows", _p->getName());
+	continue;
+      }
+      atrace_advance_time (tr, start - cur);
+      cur = start;
+      for (int k=0; k < nwin; k++) {
+	for (int oo=0; oo < _num_outputs; oo++) {
+	  v[oo*nwin + k] = ATRACE_NODE_FLOATVAL (outnode[oo]);
+	}
+	atrace_advance_time (tr, 1);
+	cur++;
+      }
+      last = start;
+    }
+
+    double peak = 0;
+    for (int k=0; k < nwin; k++) {
+      t[k] = k*step;
+      y[k] = v[o*nwin + k];
+      if (fabs (y[k]) > peak) {
+	peak = fabs (y[k]);
+      }
+    }
+
+    struct ccs_wave *w = &dyn[j].ccs[ns + nload*nslew];
+    w->n = ccs_select (nwin, t, y, maxpts, tol*peak, sel);
+    MALLOC (w->t, double, w->n);
+    MALLOC (w->i, double, w->n);
+    for (int k=0; k < w->n; k++) {
+      w->t[k] = t[sel[k]];
+      w->i[k] = y[sel[k]];
+    }
+
+    /* -- the input crosses 50% half way through its ramp -- */
+    double correction;
+    if (dyn[j].in_init == 0) {
+      correction = (config_get_real ("xcell.waveform.rise_high") -
+		    config_get_real ("xcell.waveform.rise_low"))/100.0;
+    }
+    else {
+      correction = (config_get_real ("xcell.waveform.fall_high") -
+		    config_get_real ("xcell.waveform.fall_low"))/100.0;
+    }
+    w->ref = 0.5e-12*slew_table[ns]/correction;
+  }
+
+  FREE (order);
+  FREE (v);
+  FREE (t);
+  FREE (y);
+  FREE (sel);
+  FREE (outnode);
+  atrace_close (tr);
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Re-run a random sample of xcell.validate scenarios with the
+ *  xcell.validate_preset settings, and report the largest difference
+ *  from the results obtained with the xcell.accuracy preset. The
+ *  characterization results themselves are left unchanged.
+ *
+ *------------------------------------------------------------------------
+ */
+void Cell::_validate_dynamic ()
+{
+  int nslew = config_get_table_size ("xcell.input_trans");
+  int nsweep = config_get_table_size ("xcell.load");
+  const char *fast = config_get_string ("xcell.accuracy");
+  const char *ref = config_get_string ("xcell.validate_preset");
+  int n = config_get_int ("xcell.validate");
+  int *sel;
+  char *in_sel;
+  double **save;
+
+  if (strcmp (fast, ref) == 0) {
+    return;
+  }
+  if (n > A_LEN (dscen)) {
+    n = A_LEN (dscen);
+  }
+  MALLOC (sel, int, n);
+  sample_indices (A_LEN (dscen), n, sel);
+  qsort (sel, n, sizeof (int), _int_cmp);
+
+  MALLOC (in_sel, char, A_LEN (dscen));
+  for (int j=0; j < A_LEN (dscen); j++) {
+    in_sel[j] = 0;
+  }
+  for (int j=0; j < n; j++) {
+    in_sel[sel[j]] = 1;
+  }
+
+  /*-- keep the results, and give the reference run fresh tables --*/
+  MALLOC (save, double *, 3*A_LEN (dyn));
+  for (int i=0; i < A_LEN (dyn); i++) {
+    save[3*i] = dyn[i].delay;
+    save[3*i+1] = dyn[i].transit;
+    save[3*i+2] = dyn[i].intpow;
+  }
+  double *nominal = _arc_tab;
+  _arc_tab = _alloc_arc_tables (nsweep*nslew);
+
+  double err[3], abserr[3];
+  for (int k=0; k < 3; k++) {
+    err[k] = 0;
+    abserr[k] = 0;
+  }
+
+  if (_sim_dynamic ("_spdv_", ref, n, sel)) {
+    for (int i=0; i < A_LEN (dyn); i++) {
+      if (!in_sel[dyn[i].scen]) continue;
+      for (int j=0; j < nsweep*nslew; j++) {
+	double r[3], f[3];
+	r[0] = dyn[i].delay[j];
+	r[1] = dyn[i].transit[j];
+	r[2] = dyn[i].intpow[j];
+	f[0] = save[3*i][j];
+	f[1] = save[3*i+1][j];
+	f[2] = save[3*i+2][j];
+	for (int k=0; k < 3; k++) {
+	  /* -- skip failed measurements -- */
+	  if (r[k] == 0 || f[k] == 0) continue;
+	  if (fabs (f[k] - r[k]) > abserr[k]) {
+	    abserr[k] = fabs (f[k] - r[k]);
+	  }
+	  if (fabs ((f[k] - r[k])/r[k]) > err[k]) {
+	    err[k] = fabs ((f[k] - r[k])/r[k]);
+	  }
+	}
+      }
+    }
+    printf ("  validate %s against %s (%d of %d scenarios): "
+	    "delay %.3g%% (%.3gps), transition %.3g%%, power %.3g%%\n",
+	    fast, ref, n, A_LEN (dscen), err[0]*100, abserr[0]*1e12,
+	    err[1]*100, err[2]*100);
+    if (err[0]*100 > config_get_real ("xcell.validate_tol") ||
+	err[1]*100 > config_get_real ("xcell.validate_tol") ||
+	err[2]*100 > config_get_real ("xcell.validate_tol")) {
+      warning ("%s: preset `%s' is off by more than %g%% from `%s'",
+	       _p->getName(), fast, config_get_real ("xcell.validate_tol"),
+	       ref);
+    }
+  }
+
+  /*-- restore the characterization results --*/
+  FREE (_arc_tab);
+  _arc_tab = nominal;
+  _bind_arc_tables (_arc_tab, nsweep*nslew);
+  FREE (save);
+  FREE (in_sel);
+  FREE (sel);
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Find the suspicious entries of the delay/transition tables and
+ *  simulate them again. An entry is suspicious if it is missing (the
+ *  delay was not measured, or exceeded 95% of the window, or there is
+ *  no output transition), or if delay or transition drops by more
+ *  than xcell.repair.tol percent from one load to the next larger
+ *  one; both entries of such a pair are suspicious.
+ *
+ *  The scenarios with suspicious entries are simulated again with
+ *  preset xcell.repair.preset and a window xcell.repair.window times
+ *  longer, and only the suspicious entries are replaced (when the
+ *  new run measured them). Internal power is left alone, as it is
+ *  always measured and is an average over the nominal window.
+ *
+ *------------------------------------------------------------------------
+ */
+void Cell::_repair_dynamic ()
+{
+  int nslew = config_get_table_size ("xcell.input_trans");
+  int nsweep = config_get_table_size ("xcell.load");
+  int npts = nslew*nsweep;
+  double tol = config_get_real ("xcell.repair.tol")/100.0;
+  double window = config_get_real ("xcell.short_window");
+  char *bad;
+  char *in_sel;
+  int *sel;
+  int nbad, nsel, nfixed;
+
+  /*-- mark the suspicious entries --*/
+  MALLOC (bad, char, A_LEN (dyn)*npts);
+  MALLOC (in_sel, char, A_LEN (dscen));
+  for (int j=0; j < A_LEN (dscen); j++) {
+    in_sel[j] = 0;
+  }
+  nbad = 0;
+  for (int i=0; i < A_LEN (dyn); i++) {
+    char *b = bad + i*npts;
+    for (int k=0; k < npts; k++) {
+      b[k] = (dyn[i].delay[k] <= 0 || dyn[i].transit[k] <= 0);
+    }
+    for (int j=0; j < nslew; j++) {
+      for (int l=1; l < nsweep; l++) {
+	int k0 = j + (l-1)*nslew;
+	int k1 = j + l*nslew;
+	if (b[k0] || b[k1]) continue;
+	if ((dyn[i].delay[k0] > 0 &&
+	     dyn[i].delay[k1] < dyn[i].delay[k0]*(1 - tol)) ||
+	    dyn[i].transit[k1] < dyn[i].transit[k0]*(1 - tol)) {
+	  b[k0] = 2;
+	  b[k1] = 2;
+	}
+      }
+    }
+    for (int k=0; k < npts; k++) {
+      if (b[k]) {
+	nbad++;
+	in_sel[dyn[i].scen] = 1;
+      }
+    }
+  }
+  if (nbad == 0) {
+    FREE (bad);
+    FREE (in_sel);
+    return;
+  }
+
+  nsel = 0;
+  MALLOC (sel, int, A_LEN (dscen));
+  for (int j=0; j < A_LEN (dscen); j++) {
+    if (in_sel[j]) {
+      sel[nsel++] = j;
+    }
+  }
+  if (verbose) {
+    for (int i=0; i < A_LEN (dyn); i++) {
+      for (int k=0; k < npts; k++) {
+	if (!bad[i*npts + k]) continue;
+	warning ("%s: arc %d slew %d load %d %s; simulating again",
+		 _p->getName(), i, k % nslew, k / nslew,
+		 bad[i*npts + k] == 1 ? "missing" : "not monotonic in load");
+      }
+    }
+  }
+
+  /*-- simulate the scenarios with fresh tables and a longer window;
+    the window and the tables are put back whether or not the
+    simulation succeeded --*/
+  double *nominal = _arc_tab;
+  double *rep = _alloc_arc_tables (npts);
+  int ok;
+
+  _arc_tab = rep;
+  config_set_real ("xcell.short_window",
+		   window*config_get_real ("xcell.repair.window"));
+  ok = _sim_dynamic ("_spdr_", config_get_string ("xcell.repair.preset"),
+		     nsel, sel);
+  config_set_real ("xcell.short_window", window);
+  _arc_tab = nominal;
+  _bind_arc_tables (_arc_tab, npts);
+
+  nfixed = 0;
+  if (ok) {
+    int na = A_LEN (dyn);
+    
+    /*-- delay tables, then transit tables; see _alloc_arc_tables --*/
+    for (int i=0; i < na; i++) {
+      for (int k=0; k < npts; k++) {
+	double d = rep[i*npts + k];
+	double t = rep[(na + i)*npts + k];
+	if (!bad[i*npts + k] || d <= 0 || t <= 0) continue;
+	nominal[i*npts + k] = d;
+	nominal[(na + i)*npts + k] = t;
+	nfixed++;
+      }
+    }
+  }
+  FREE (rep);
+
+  printf ("  repair: %d suspicious entries in %d of %d scenarios, "
+	  "%d replaced\n", nbad, nsel, A_LEN (dscen), nfixed);
+  if (nfixed < nbad) {
+    warning ("%s: %d table entries are still missing or not monotonic",
+	     _p->getName(), nbad - nfixed);
+  }
+  FREE (sel);
+  FREE (in_sel);
+  FREE (bad);
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Sequential cells (external flip-flops and latches)
+ *
+ *  Every measurement uses the same slot shape, with te = t0 + 3w
+ *  (w = xcell.short_window) and a slot length of 5w:
+ *
+ *    clock : clk[0] at t0, clk[1] at t0+0.5w, clk[2] at t0+1.5w,
+ *            clk[3] at te
+ *    data  : old value from t0, then the test events relative to te
+ *
+ *  The first clock pulse captures the old data value, so the output
+ *  is in a known state before the test edge at te.
+ *
+ *------------------------------------------------------------------------
+ */
+
+/* -- the capture edge is rising for ffpos and for latchlo -- */
+#define SEQ_CAPTURE_RISE(t) ((t) == 1 || (t) == 4)
+#define SEQ_IS_LATCH(t) ((t) == 3 || (t) == 4)
+
+struct seq_slot {
+  int clk[4];			// clock levels
+  int nd;			// # data events
+  double dt[2];			// data event time (50%), relative to te
+  int dv[2];			// data event value
+};
+
+/*
+  One transition of a PWL source: from vold to vnew, crossing 50% at
+  time t (ps) with a ramp of r (ps)
+*/
+static void print_edge (FILE *fp, double t, double r, int vold, int vnew)
+{
+  double vdd = config_get_real ("xcell.Vdd");
+  fprintf (fp, "+");
+  print_number (fp, 1e-12*(t - r/2));
+  fprintf (fp, " %g ", vold ? vdd : 0.0);
+  print_number (fp, 1e-12*(t + r/2));
+  fprintf (fp, " %g\n", vnew ? vdd : 0.0);
+}
+
+/* -- ramp duration for a given 10-90 (or configured) slew -- */
+static double slew_ramp (double slew, int rise)
+{
+  double correction;
+  if (rise) {
+    correction = (config_get_real ("xcell.waveform.rise_high") -
+		  config_get_real ("xcell.waveform.rise_low"))/100.0;
+  }
+  else {
+    correction = (config_get_real ("xcell.waveform.fall_high") -
+		  config_get_real ("xcell.waveform.fall_low"))/100.0;
+  }
+  return slew/correction;
+}
+
+
+/*
+  Write the input sources for n slots. slot_t[] has the slot start
+  times; clk_slew[]/data_slew[] the slews per slot; din is the data
+  input being exercised, and old[] its value at the start of each
+  slot. All other inputs are held at the xcell.cells.<cell>.idle
+  vector.
+*/
+void Cell::_seq_print_slots (FILE *sfp, int n, double *slot_t,
+			     struct seq_slot *sl, double *clk_slew,
+			     double *data_slew, int din, int *old)
+{
+  double window = config_get_real ("xcell.short_window");
+  double vdd = config_get_real ("xcell.Vdd");
+  char buf[1024];
+  int idle = 0;
+
+  snprintf (buf, 1024, "%s.idle", _cellinfo (_p));
+  if (config_exists (buf)) {
+    idle = config_get_int (buf);
+  }
+
+  for (int i=0; i < _num_inputs; i++) {
+    int cur;
+
+    if (i == _clock_pin) {
+      cur = sl[0].clk[0];
+    }
+    else if (i == din) {
+      cur = old[0];
+    }
+    else {
+      cur = (idle >> i) & 1;
+    }
+    fprintf (sfp, "Vn%d p%d 0 PWL (0p %g %gp %g\n", _get_input_pin (i),
+	     _get_input_pin (i), cur ? vdd : 0.0, slot_t[0], cur ? vdd : 0.0);
+
+    if (i != _clock_pin && i != din) {
+      fprintf (sfp, "+)\n\n");
+      continue;
+    }
+    for (int s=0; s < n; s++) {
+      double t0 = slot_t[s];
+      double te = t0 + 3*window;
+      if (i == _clock_pin) {
+	double tc[4] = { t0 + 0.1*window, t0 + 0.5*window,
+			 t0 + 1.5*window, te };
+	for (int k=0; k < 4; k++) {
+	  print_edge (sfp, tc[k], slew_ramp (clk_slew[s], !cur),
+		      cur, sl[s].clk[k]);
+	  cur = sl[s].clk[k];
+	}
+      }
+      else {
+	print_edge (sfp, t0 + 0.1*window, slew_ramp (data_slew[s], !cur),
+		    cur, old[s]);
+	cur = old[s];
+	for (int k=0; k < sl[s].nd; k++) {
+	  print_edge (sfp, te + sl[s].dt[k], slew_ramp (data_slew[s], !cur),
+		      cur, sl[s].dv[k]);
+	  cur = sl[s].dv[k];
+	}
+      }
+    }
+    fprintf (sfp, "+)\n\n");
+  }
+}
+
+
+/*
+  Constraint searches: one per (data input, setup/hold, data
+  direction, clock slew, data slew). Each one is a bisection on the
+  time between the data and clock edges, where larger is always safer:
+
+    setup : data switches to its new value s before the clock edge
+    hold  : data is at its new value well before the clock edge, and
+            goes back h after it
+
+  and the probe passes if every output (all of them follow the stored
+  state, see _seq_clk2q) changes state at the test edge.
+  Every round writes one deck per unfinished search with
+  xcell.seq.probes evenly spaced probe points, and all the decks of a
+  round run in parallel.
+*/
+struct seq_search {
+  int arc;			// seq[] entry
+  int ci, di;			// clock, data slew index
+  double lo, hi;		// lo fails, hi passes
+  int done;
+};
+
+int Cell::_seq_constraints ()
+{
+  int nslew = config_get_table_size ("xcell.input_trans");
+  double *slew_table = config_get_table_real ("xcell.input_trans");
+  double window = config_get_real ("xcell.short_window");
+  double vhigh = config_get_real ("lint.V_high");
+  double vlow = config_get_real ("lint.V_low");
+  int nprobe = config_get_int ("xcell.seq.probes");
+  double tol = config_get_real ("xcell.seq.tol");
+  int capture_rise = SEQ_CAPTURE_RISE (_ext_type);
+  A_DECL (struct seq_search, srch);
+  char buf[1024];
+  char file[1024];
+  int rounds = 0;
+
+  if (nprobe < 1) {
+    nprobe = 1;
+  }
+  if (tol <= 0) {
+    tol = 1;
+  }
+
+  A_INIT (srch);
+  for (int d=0; d < _num_inputs; d++) {
+    if (d == _clock_pin) continue;
+    for (int type=SEQ_SETUP; type <= SEQ_HOLD; type++) {
+      for (int dir=0; dir < 2; dir++) {
+	A_NEW (seq, struct seq_arc);
+	A_NEXT (seq).type = type;
+	A_NEXT (seq).pin = d;
+	A_NEXT (seq).dir = dir;
+	MALLOC (A_NEXT (seq).val, double, nslew*nslew);
+	A_NEXT (seq).transit = NULL;
+	for (int ci=0; ci < nslew; ci++) {
+	  for (int di=0; di < nslew; di++) {
+	    A_NEW (srch, struct seq_search);
+	    A_NEXT (srch).arc = A_LEN (seq);
+	    A_NEXT (srch).ci = ci;
+	    A_NEXT (srch).di = di;
+	    A_NEXT (srch).lo = -0.5*window;
+	    A_NEXT (srch).hi = 0.9*window;
+	    A_NEXT (srch).done = 0;
+	    A_INC (srch);
+	  }
+	}
+	A_INC (seq);
+      }
+    }
   }
 
-  if (!weird_error) {
-    unlink_generic (file);
+  struct job_pool *jp = jobs_new (jobs_max ());
+  int nleft = A_LEN (srch);
+
+  while (nleft > 0) {
+    /* round 0 also checks the end points of the range */
+    int np = (rounds == 0) ? nprobe + 2 : nprobe;
+    double *probe;
+    int *ids;
+    double *lim;
+
+    MALLOC (probe, double, A_LEN (srch)*np);
+    MALLOC (ids, int, A_LEN (srch));
+    MALLOC (lim, double, A_LEN (srch));
+
+    for (int s=0; s < A_LEN (srch); s++) {
+      struct seq_search *sr = &srch[s];
+      struct seq_arc *arc = &seq[sr->arc];
+      if (sr->done) continue;
+
+      for (int k=0; k < np; k++) {
+	if (rounds == 0) {
+	  probe[s*np + k] = sr->lo + (sr->hi - sr->lo)*k/(np-1);
+	}
+	else {
+	  probe[s*np + k] = sr->lo + (sr->hi - sr->lo)*(k+1)/(np+1);
+	}
+      }
+
+      snprintf (file, 1024, "_spsq%d_", s);
+      a->msnprintfproc (file + strlen (file), 1024 - strlen (file), _p);
+      snprintf (buf, 1024, "%s.spi", file);
+      FILE *sfp = fopen (buf, "w");
+      if (!sfp) {
+	FREE (probe);
+	FREE (ids);
+	FREE (lim);
+	jobs_free (jp);
+	A_FREE (srch);
+	return _fail (NULL, "Could not open `%s' for writing", buf);
+      }
+      if (!_gen_spice_header (sfp)) {
+	fclose (sfp);
+	unlink (buf);
+	FREE (probe);
+	FREE (ids);
+	FREE (lim);
+	jobs_free (jp);
+	A_FREE (srch);
+	return 0;
+      }
+      print_sim_options (sfp, config_get_string ("xcell.accuracy"));
+
+      struct timeline tl;
+      double *slot_t, *cs, *ds;
+      struct seq_slot *sl;
+      int *old;
+      int oldv = arc->dir;	/* dir 0: data rises */
+
+      MALLOC (slot_t, double, np);
+      MALLOC (cs, double, np);
+      MALLOC (ds, double, np);
+      MALLOC (sl, struct seq_slot, np);
+      MALLOC (old, int, np);
+      timeline_init (&tl, 1000);
+      for (int k=0; k < np; k++) {
+	slot_t[k] = timeline_alloc (&tl, 5*window);
+	cs[k] = slew_table[sr->ci];
+	ds[k] = slew_table[sr->di];
+	old[k] = oldv;
+	sl[k].clk[0] = !capture_rise;
+	sl[k].clk[1] = capture_rise;
+	sl[k].clk[2] = !capture_rise;
+	sl[k].clk[3] = capture_rise;
+	if (arc->type == SEQ_SETUP) {
+	  sl[k].nd = 1;
+	  sl[k].dt[0] = -probe[s*np + k];
+	  sl[k].dv[0] = !oldv;
+	}
+	else {
+	  sl[k].nd = 2;
+	  sl[k].dt[0] = -window;
+	  sl[k].dv[0] = !oldv;
+	  sl[k].dt[1] = probe[s*np + k];
+	  sl[k].dv[1] = oldv;
+	}
+      }
+      _seq_print_slots (sfp, np, slot_t, sl, cs, ds, arc->pin, old);
+
+      for (int k=0; k < np; k++) {
+	for (int o=0; o < _num_outputs; o++) {
+	  fprintf (sfp, ".measure tran qref_%d_%d find V(p%d) at=%gp\n",
+		   o, k, _get_output_pin (o), slot_t[k] + 1.4*window);
+	  fprintf (sfp, ".measure tran qend_%d_%d find V(p%d) at=%gp\n",
+		   o, k, _get_output_pin (o), slot_t[k] + 4.9*window);
+	}
+      }
+      fprintf (sfp, "\n");
+      print_tran (sfp, config_get_string ("xcell.accuracy"),
+		  timeline_end (&tl));
+      fprintf (sfp, "\n");
+      if (is_hspice()) {
+	fprintf (sfp, ".options measform=2\n");
+      }
+      fprintf (sfp, "\n.end\n");
+      fclose (sfp);
+      snprintf (buf, 1024, "%s.spi", file);
+      prof_deck (buf, timeline_end (&tl), 1);
+      lim[s] = wd_limit (buf, timeline_end (&tl), 1);
+
+      FREE (slot_t);
+      FREE (cs);
+      FREE (ds);
+      FREE (sl);
+      FREE (old);
+
+      snprintf (buf, 1024, "%s %s.spi > %s.log 2>&1",
+		config_get_string ("xcell.spice_binary"), file, file);
+      ids[s] = jobs_submit_limit (jp, buf, lim[s]);
+    }
+    prof_begin (NULL, "sim");
+    jobs_wait (jp);
+    prof_end ();
+
+    /* -- update the search intervals -- */
+    for (int s=0; s < A_LEN (srch); s++) {
+      struct seq_search *sr = &srch[s];
+      struct Hashtable *H;
+      if (sr->done) continue;
+
+      snprintf (file, 1024, "_spsq%d_", s);
+      a->msnprintfproc (file + strlen (file), 1024 - strlen (file), _p);
+      if (jobs_status (jp, ids[s]) == JOBS_TIMEOUT) {
+	snprintf (buf, 1024, "%s.spi", file);
+	wd_timeout (buf, lim[s], "cell failed");
+	FREE (probe);
+	FREE (ids);
+	FREE (lim);
+	jobs_free (jp);
+	A_FREE (srch);
+	return _fail (file, "Setup/hold search simulation timed out");
+      }
+      snprintf (buf, 1024, "%s.spi.mt0", file);
+      H = parse_measurements (buf);
+      if (!H) {
+	snprintf (buf, 1024, "%s.mt0", file);
+	H = parse_measurements (buf);
+	if (!H) {
+	  FREE (probe);
+	  FREE (ids);
+	  FREE (lim);
+	  jobs_free (jp);
+	  A_FREE (srch);
+	  return _fail (file, "Could not open measurement output file %s",
+			buf);
+	}
+      }
+
+      int first_pass = -1;
+      for (int k=0; k < np && first_pass == -1; k++) {
+	int pass = 1;
+	for (int o=0; pass && o < _num_outputs; o++) {
+	  hash_bucket_t *b0, *b1;
+	  snprintf (buf, 1024, "qref_%d_%d", o, k);
+	  b0 = hash_lookup (H, buf);
+	  snprintf (buf, 1024, "qend_%d_%d", o, k);
+	  b1 = hash_lookup (H, buf);
+	  if (!b0 || !b1 || !((b0->f <= vlow && b1->f >= vhigh) ||
+			      (b0->f >= vhigh && b1->f <= vlow))) {
+	    pass = 0;
+	  }
+	}
+	if (pass) {
+	  first_pass = k;
+	}
+      }
+      hash_free (H);
+      unlink_generic (file);
+
+      if (rounds == 0) {
+	if (first_pass == -1) {
+	  warning ("%s: %s search for input %d did not converge; using %g",
+		   _p->getName(),
+		   seq[sr->arc].type == SEQ_SETUP ? "setup" : "hold",
+		   seq[sr->arc].pin, sr->hi);
+	  sr->lo = sr->hi;
+	}
+	else if (first_pass == 0) {
+	  sr->hi = sr->lo;
+	}
+	else {
+	  sr->hi = probe[s*np + first_pass];
+	  sr->lo = probe[s*np + first_pass - 1];
+	}
+      }
+      else {
+	if (first_pass == -1) {
+	  sr->lo = probe[s*np + np - 1];
+	}
+	else {
+	  sr->hi = probe[s*np + first_pass];
+	  if (first_pass > 0) {
+	    sr->lo = probe[s*np + first_pass - 1];
+	  }
+	}
+      }
+      if (sr->hi - sr->lo <= tol) {
+	sr->done = 1;
+	seq[sr->arc].val[sr->ci*nslew + sr->di] = sr->hi;
+	nleft--;
+      }
+    }
+    FREE (probe);
+    FREE (ids);
+    FREE (lim);
+    rounds++;
   }
+  jobs_free (jp);
 
-  /* Xyce creates multiple measurement files */
-  if (!weird_error && is_xyce()) {
-    /* -- other measurement files -- */
-    for (int i=1; i < config_get_table_size ("xcell.load"); i++) {
+  if (verbose) {
+    printf ("  %d constraint searches, %d rounds\n", A_LEN (srch), rounds);
+  }
+  A_FREE (srch);
+  return 1;
+}
+
+
+/*
+  Clock-to-output arcs: for each clock slew and new data value, the
+  data input settles well before the launching edge (the capture edge
+  for flip-flops, the opening edge for latches), and the delay and
+  transition of every output are measured over the load sweep.
+*/
+int Cell::_seq_clk2q ()
+{
+  int nslew = config_get_table_size ("xcell.input_trans");
+  double *slew_table = config_get_table_real ("xcell.input_trans");
+  int nsweep = config_get_table_size ("xcell.load");
+  double window = config_get_real ("xcell.short_window");
+  double vdd = config_get_real ("xcell.Vdd");
+  int capture_rise = SEQ_CAPTURE_RISE (_ext_type);
+  int launch_rise = SEQ_IS_LATCH (_ext_type) ? !capture_rise : capture_rise;
+  int din = (_clock_pin == 0 ? 1 : 0);
+  char buf[1024];
+  char file[1024];
+  FILE *sfp;
+
+  snprintf (file, 1024, "_spcq_");
+  a->msnprintfproc (file + 6, 1018, _p);
+  snprintf (buf, 1024, "%s.spi", file);
+  sfp = fopen (buf, "w");
+  if (!sfp) {
+    return _fail (NULL, "Could not open `%s' for writing", buf);
+  }
+  if (!_gen_spice_header (sfp)) {
+    fclose (sfp);
+    unlink (buf);
+    return 0;
+  }
+  print_sim_options (sfp, config_get_string ("xcell.accuracy"));
+
+  /*-- slot 2*ns + v: clock slew ns, data goes to v --*/
+  int nslots = 2*nslew;
+  struct timeline tl;
+  double *slot_t, *cs;
+  struct seq_slot *sl;
+  int *old;
+
+  MALLOC (slot_t, double, nslots);
+  MALLOC (cs, double, nslots);
+  MALLOC (sl, struct seq_slot, nslots);
+  MALLOC (old, int, nslots);
+  timeline_init (&tl, 1000);
+  for (int k=0; k < nslots; k++) {
+    slot_t[k] = timeline_alloc (&tl, 5*window);
+    cs[k] = slew_table[k/2];
+    old[k] = !(k % 2);
+    if (SEQ_IS_LATCH (_ext_type)) {
+      /* open, close, stay closed, open at te */
+      sl[k].clk[0] = launch_rise;
+      sl[k].clk[1] = !launch_rise;
+      sl[k].clk[2] = !launch_rise;
+      sl[k].clk[3] = launch_rise;
+    }
+    else {
+      sl[k].clk[0] = !launch_rise;
+      sl[k].clk[1] = launch_rise;
+      sl[k].clk[2] = !launch_rise;
+      sl[k].clk[3] = launch_rise;
+    }
+    sl[k].nd = 1;
+    sl[k].dt[0] = -window;
+    sl[k].dv[0] = (k % 2);
+  }
+  _seq_print_slots (sfp, nslots, slot_t, sl, cs, cs, din, old);
+
+  for (int k=0; k < nslots; k++) {
+    double te = slot_t[k] + 3*window;
+    for (int o=0; o < _num_outputs; o++) {
+      int q = _get_output_pin (o);
+      fprintf (sfp, ".measure tran cq_%d_%d trig V(p%d) VAL=%g TD=%gp CROSS=1 targ V(p%d) VAL=%g TD=%gp CROSS=1\n", o, k, _get_input_pin (_clock_pin), vdd*0.5, te - 0.5*window, q, vdd*0.5, te - 0.5*window);
+      fprintf (sfp, ".measure tran cqref_%d_%d find V(p%d) at=%gp\n", o, k,
+	       q, te - 0.05*window);
+      fprintf (sfp, ".measure tran cqtr_%d_%d trig V(p%d) VAL=%g TD=%gp RISE=1 targ V(p%d) VAL=%g TD=%gp RISE=1\n", o, k, q,
+	       vdd*config_get_real ("xcell.waveform.rise_low")/100.0,
+	       te - 0.5*window, q,
+	       vdd*config_get_real ("xcell.waveform.rise_high")/100.0,
+	       te - 0.5*window);
+      fprintf (sfp, ".measure tran cqtf_%d_%d trig V(p%d) VAL=%g TD=%gp FALL=1 targ V(p%d) VAL=%g TD=%gp FALL=1\n", o, k, q,
+	       vdd*config_get_real ("xcell.waveform.fall_high")/100.0,
+	       te - 0.5*window, q,
+	       vdd*config_get_real ("xcell.waveform.fall_low")/100.0,
+	       te - 0.5*window);
+    }
+  }
+  FREE (slot_t);
+  FREE (cs);
+  FREE (sl);
+  FREE (old);
+
+  fprintf (sfp, "\n");
+  print_tran (sfp, config_get_string ("xcell.accuracy"), timeline_end (&tl));
+  if (is_xyce()) {
+    fprintf (sfp, "\n.step load LIST ");
+  }
+  else {
+    fprintf (sfp, " SWEEP load POI %d", nsweep);
+  }
+  double *load_table = config_get_table_real ("xcell.load");
+  for (int i=0; i < nsweep; i++) {
+    fprintf (sfp, " %gf", load_table[i]);
+  }
+  fprintf (sfp, "\n\n");
+  if (is_hspice()) {
+    fprintf (sfp, ".options measform=2\n");
+  }
+  fprintf (sfp, "\n.end\n");
+  fclose (sfp);
+  snprintf (buf, 1024, "%s.spi", file);
+  prof_deck (buf, timeline_end (&tl), 2*_num_outputs);
+  double limit = wd_limit (buf, timeline_end (&tl), nsweep);
+
+  snprintf (buf, 1024, "%s %s.spi > %s.log 2>&1",
+	    config_get_string ("xcell.spice_binary"), file, file);
+  if (prof_system ("sim", buf, limit) == JOBS_TIMEOUT) {
+    snprintf (buf, 1024, "%s.spi", file);
+    wd_timeout (buf, limit, "cell failed");
+    return _fail (file, "Clock-to-output simulation timed out");
+  }
+
+  /*-- one arc per output and new data value; arc (o, v) is at
+    index base + 2*o + v --*/
+  int base = A_LEN (seq);
+  for (int o=0; o < _num_outputs; o++) {
+    for (int v=0; v < 2; v++) {
+      A_NEW (seq, struct seq_arc);
+      A_NEXT (seq).type = SEQ_CLK2Q;
+      A_NEXT (seq).pin = o;
+      A_NEXT (seq).dir = -1;
+      MALLOC (A_NEXT (seq).val, double, nslew*nsweep);
+      MALLOC (A_NEXT (seq).transit, double, nslew*nsweep);
+      for (int j=0; j < nslew*nsweep; j++) {
+	A_NEXT (seq).val[j] = 0;
+	A_NEXT (seq).transit[j] = 0;
+      }
+      A_INC (seq);
+    }
+  }
+
+  for (int nload=0; nload < nsweep; nload++) {
+    struct Hashtable *H;
+    hash_bucket_t *b;
+
+    if (is_xyce()) {
+      snprintf (buf, 1024, "%s.spi.mt%d", file, nload);
+      H = parse_measurements (buf);
+    }
+    else {
+      snprintf (buf, 1024, "%s.mt0", file);
+      H = parse_measurements (buf, "load", nload);
+    }
+    if (!H) {
+      return _fail (file, "Could not open measurement output file %s", buf);
+    }
+    for (int o=0; o < _num_outputs; o++) {
+      for (int k=0; k < nslots; k++) {
+	struct seq_arc *arc = &seq[base + 2*o + (k % 2)];
+	int ns = k/2;
+	int rise;
+
+	/* -- output direction from its value just before the edge -- */
+	snprintf (buf, 1024, "cqref_%d_%d", o, k);
+	b = hash_lookup (H, buf);
+	if (!b) continue;
+	rise = (b->f < 0.5*vdd);
+	if (arc->dir == -1) {
+	  arc->dir = rise ? 0 : 1;
+	}
+
+	snprintf (buf, 1024, "cq_%d_%d", o, k);
+	b = hash_lookup (H, buf);
+	if (b && b->f != -1) {
+	  arc->val[ns + nload*nslew] = b->f;
+	}
+	snprintf (buf, 1024, "cqt%c_%d_%d", rise ? 'r' : 'f', o, k);
+	b = hash_lookup (H, buf);
+	if (b && b->f != -1) {
+	  arc->transit[ns + nload*nslew] = b->f;
+	}
+      }
+    }
+    hash_free (H);
+  }
+
+  /*-- data rising gives a rising output for a non-inverting output --*/
+  for (int o=0; o < _num_outputs; o++) {
+    _seq_inv[o] = (seq[base + 2*o + 1].dir == 1) ? 1 : 0;
+  }
+
+  unlink_generic (file);
+  if (is_xyce()) {
+    for (int i=1; i < nsweep; i++) {
       snprintf (buf, 1024, "%s.spi.mt%d", file, i);
       unlink (buf);
     }
     snprintf (buf, 1024, "%s.spi.res", file);
     unlink (buf);
   }
-
   return 1;
 }
 
 
+int Cell::_run_sequential ()
+{
+  char buf[1024];
+
+  if (!nl) {
+    return 0;
+  }
+
+  snprintf (buf, 1024, "%s.clock", _cellinfo (_p));
+  if (!config_exists (buf)) {
+    warning ("%s: sequential cell needs %s (clock input)", _p->getName(),
+	     buf);
+    return 0;
+  }
+  _clock_pin = config_get_int (buf);
+  if (_clock_pin < 0 || _clock_pin >= _num_inputs || _num_inputs < 2) {
+    warning ("%s: bad clock input %d", _p->getName(), _clock_pin);
+    return 0;
+  }
+
+  MALLOC (_seq_inv, int, _num_outputs);
+  for (int i=0; i < _num_outputs; i++) {
+    _seq_inv[i] = 0;
+  }
+
+  if (!_seq_clk2q ()) {
+    return 0;
+  }
+  return _seq_constraints ();
+}
+
+
+/*-- ff/latch group that defines the internal state IQ/IQN --*/
+void Cell::_emit_seq_state ()
+{
+  char buf[1024];
+  char cbuf[1024];
+  const char *cprefix = _p ? _cellinfo (_p) : _db_cfg;
+
+  if (!_has_data() || !_seq_inv) return;
+
+  _sprint_input_pin (cbuf, 1024, _clock_pin);
+
+  snprintf (buf, 1024, "%s.next_state", cprefix);
+  if (config_exists (buf)) {
+    snprintf (buf, 1024, "%s", config_get_string (buf));
+  }
+  else {
+    _sprint_input_pin (buf, 1024, (_clock_pin == 0 ? 1 : 0));
+  }
+
+  CNLFP (_lfp, "%s(IQ,IQN) {\n", SEQ_IS_LATCH (_ext_type) ? "latch" : "ff");
+  _l->_tab();
+  if (SEQ_IS_LATCH (_ext_type)) {
+    CNLFP (_lfp, "data_in : \"");
+    a->mfprintf (_lfp, "%s", buf);
+    fprintf (_lfp, "\";\n");
+    /* -- latchhi is transparent when the clock is high -- */
+    CNLFP (_lfp, "enable : \"%s", _ext_type == 3 ? "" : "!");
+    a->mfprintf (_lfp, "%s", cbuf);
+    fprintf (_lfp, "\";\n");
+  }
+  else {
+    CNLFP (_lfp, "next_state : \"");
+    a->mfprintf (_lfp, "%s", buf);
+    fprintf (_lfp, "\";\n");
+    CNLFP (_lfp, "clocked_on : \"%s", _ext_type == 1 ? "" : "!");
+    a->mfprintf (_lfp, "%s", cbuf);
+    fprintf (_lfp, "\";\n");
+  }
+  _l->_untab();
+  CNLFP (_lfp, "}\n");
+}
+
+
+/*-- values(...) for an nrow x ncol table stored as val[r + c*nrow] --*/
+void Cell::_emit_table_values (double *val, int nrow, int ncol, double scale)
+{
+  CNLFP (_lfp, "values(\\\n"); _l->_tab();
+  for (int j=0; j < nrow; j++) {
+    CNLFP (_lfp, "\"");
+    for (int k=0; k < ncol; k++) {
+      if (k != 0) {
+	fprintf (_lfp, ", ");
+      }
+      _l->_val (val[j + k*nrow]*scale);
+    }
+    fprintf (_lfp, "\"");
+    if (j != nrow-1) {
+      fprintf (_lfp, ",");
+    }
+    fprintf (_lfp, "\\\n");
+  }
+  _l->_untab();
+  CNLFP (_lfp, ");\n");
+}
+
+
+/*-- setup/hold constraints on data input pin ---*/
+void Cell::_emit_seq_constraints (int pin)
+{
+  int nslew = config_get_table_size ("xcell.input_trans");
+  const char *edge = SEQ_CAPTURE_RISE (_ext_type) ? "rising" : "falling";
+  double *tab;
+
+  if (!_seq_inv) return;
+
+  if (pin == _clock_pin) {
+    CNLFP (_lfp, "clock : true;\n");
+    return;
+  }
+
+  MALLOC (tab, double, nslew*nslew);
+  for (int type=SEQ_SETUP; type <= SEQ_HOLD; type++) {
+    int found = 0;
+    for (int i=0; i < A_LEN (seq); i++) {
+      if (seq[i].type != type || seq[i].pin != pin) continue;
+      if (!found) {
+	CNLFP (_lfp, "timing() {\n");
+	_l->_tab();
+	CNLFP (_lfp, "related_pin: \"");
+	fputs (_lib_pin (_clock_pin), _lfp);
+	fprintf (_lfp, "\";\n");
+	CNLFP (_lfp, "timing_type : %s_%s;\n",
+	       type == SEQ_SETUP ? "setup" : "hold", edge);
+	found = 1;
+      }
+      CNLFP (_lfp, "%s_constraint(constraint_%dx%d) {\n",
+	     seq[i].dir == 0 ? "rise" : "fall", nslew, nslew);
+      _l->_tab();
+      _l->_dump_index_table (1, nslew, _l->_trans);
+      fprintf (_lfp, "\n");
+      _l->_dump_index_table (2, nslew, _l->_trans);
+      fprintf (_lfp, "\n");
+      /* -- val[] is [clock slew][data slew]; rows are clock slew -- */
+      for (int ci=0; ci < nslew; ci++) {
+	for (int di=0; di < nslew; di++) {
+	  tab[ci + di*nslew] = seq[i].val[ci*nslew + di];
+	}
+      }
+      _emit_table_values (tab, nslew, nslew,
+			  1e-12/config_get_real ("xcell.units.time_conv"));
+      _l->_untab();
+      CNLFP (_lfp, "}\n");
+    }
+    if (found) {
+      _l->_untab();
+      CNLFP (_lfp, "}\n");
+    }
+  }
+  FREE (tab);
+}
+
+
+/*-- clock-to-output arcs on output pin ---*/
+void Cell::_emit_seq_clk2q (int nout)
+{
+  int nslew = config_get_table_size ("xcell.input_trans");
+  int nsweep = config_get_table_size ("xcell.load");
+  int launch_rise = SEQ_CAPTURE_RISE (_ext_type);
+
+  if (!_seq_inv) return;
+
+  if (SEQ_IS_LATCH (_ext_type)) {
+    launch_rise = !launch_rise;
+  }
+
+  CNLFP (_lfp, "timing() {\n");
+  _l->_tab();
+  CNLFP (_lfp, "related_pin: \"");
+  fputs (_lib_pin (_clock_pin), _lfp);
+  fprintf (_lfp, "\";\n");
+  CNLFP (_lfp, "timing_type : %s_edge;\n", launch_rise ? "rising" : "falling");
+
+  for (int i=0; i < A_LEN (seq); i++) {
+    if (seq[i].type != SEQ_CLK2Q || seq[i].pin != nout) continue;
+    if (seq[i].dir == -1) continue;
+
+    CNLFP (_lfp, "cell_%s(delay_%dx%d) {\n", seq[i].dir == 0 ? "rise" : "fall",
+	   nslew, nsweep);
+    _l->_tab();
+    _l->dump_index_tables ();
+    _emit_table_values (seq[i].val, nslew, nsweep,
+			1/config_get_real ("xcell.units.time_conv"));
+    _l->_untab();
+    CNLFP (_lfp, "}\n");
+
+    CNLFP (_lfp, "%s_transition(delay_%dx%d) {\n",
+	   seq[i].dir == 0 ? "rise" : "fall", nslew, nsweep);
+    _l->_tab();
+    _l->dump_index_tables ();
+    _emit_table_values (seq[i].transit, nslew, nsweep,
+			1/config_get_real ("xcell.units.time_conv"));
+    _l->_untab();
+    CNLFP (_lfp, "}\n");
+  }
+  _l->_untab();
+  CNLFP (_lfp, "}\n");
+}
+
+#undef SEQ_CAPTURE_RISE
+#undef SEQ_IS_LATCH
+
 
 void Cell::_emit_dynamic ()
 {
@@ -2333,14 +5479,43 @@ void Cell::_emit_dynamic ()
   
   char buf[1024];
   
-  if (!nl) return;
+  if (!_has_data()) return;
+
+  /*-- the tables as printed: unit conversion of delay and transition,
+    and leakage subtraction and energy scaling of internal power, as
+    passes over the arc table block --*/
+  int narc = A_LEN (dyn);
+  int npts = nslew*nsweep;
+  double *val = NULL;
+
+  if (narc > 0 && _arc_tab) {
+    double tconv = config_get_real ("xcell.units.time_conv");
+
+    MALLOC (val, double, 3*narc*npts);
+    for (int k=0; k < 2*narc*npts; k++) {
+      val[k] = _arc_tab[k]/tconv;
+    }
+    for (int i=0; i < narc; i++) {
+      double *src = dyn[i].intpow;
+      double *dst = val + (2*narc + i)*npts;
+      double lk = leakage_power[dyn[i].idx[dyn[i].nidx-1]];
+
+      if (dyn[i].scen >= 0) {
+	/* leakage is shared with other arcs in the scenario */
+	lk = lk/dscen[dyn[i].scen].narcs;
+      }
+      /* internal power is always in fJ: picoseconds * power */
+      for (int k=0; k < npts; k++) {
+	dst[k] = (src[k] - lk)*window*1e-12/1e-15;
+      }
+    }
+  }
   
   for (int nout=0; nout < _num_outputs; nout++) {
     int is_comb;
-    char buf[1024];
+    const char *outpin = _lib_pin (_num_inputs + nout);
     CNLFP (_lfp, "pin(");
-    _sprint_output_pin (buf, 1024, nout);
-    a->mfprintf (_lfp, "%s", buf);
+    fputs (outpin, _lfp);
     fprintf (_lfp, ") {\n");
     _l->_tab ();
     
@@ -2352,23 +5527,17 @@ void Cell::_emit_dynamic ()
       if (fn_override) {
 	fprintf (_lfp, "%s", fn_override[nout]);
       }
+      else if (_seq_inv) {
+	is_comb = 0;
+	fprintf (_lfp, "%s", _seq_inv[nout] ? "IQN" : "IQ");
+      }
       else if (_num_stateholding == 0 || _is_out[nout] == 0) {
-	int first = 1;
 	is_comb = 1;
 	
 	/*-- print function --*/
-	for (int i=0; i < (1 << _num_inputs); i++) {
-	  if (bitset_tst (_outvals[nout], i)) {
-	    if (!first) {
-	      fprintf (_lfp, "+");
-	    }
-	    first = 0;
-	    _print_input_case (i);
-	  }
-	}
+	_print_sop (_outvals[nout]);
       }
       else {
-	int first = 1;
 	int sh_idx;
 
 	is_comb = 0;
@@ -2382,61 +5551,23 @@ void Cell::_emit_dynamic ()
 
 	if (_is_out[nout] > 0) {
 	  /*-- this output is the state-holding gate --*/
-	  for (int i=0; i < (1 << _num_inputs); i++) {
-	    if (bitset_tst (_stateholding[sh_idx].st[1], i)) {
-	      if (!first) {
-		fprintf (_lfp, "+");
-	      }
-	      first = 0;
-	      _print_input_case (i);
-	    }
-	  }
-	  if (!first) {
+	  if (_print_sop (_stateholding[sh_idx].st[1]) > 0) {
 	    fprintf (_lfp, "+");
-	    first = 0;
 	  }
-	  a->mfprintf (_lfp, "%s", buf);
+	  fputs (outpin, _lfp);
 	  fprintf (_lfp, "*!(");
-	  first = 1;
-	  for (int i=0; i < (1 << _num_inputs); i++) {
-	    if (bitset_tst (_stateholding[sh_idx].st[0], i)) {
-	      if (!first) {
-		fprintf (_lfp, "+");
-	      }
-	      first = 0;
-	      _print_input_case (i);
-	    }
-	  }
+	  _print_sop (_stateholding[sh_idx].st[0]);
 	  fprintf (_lfp, ")");
 	}
 	else {
 	  Assert (_is_out[nout] < 0, "Hmm");
 	  /*-- this output is the state-holding gate --*/
-	  for (int i=0; i < (1 << _num_inputs); i++) {
-	    if (bitset_tst (_stateholding[sh_idx].st[0], i)) {
-	      if (!first) {
-		fprintf (_lfp, "+");
-	      }
-	      first = 0;
-	      _print_input_case (i);
-	    }
-	  }
-	  if (!first) {
+	  if (_print_sop (_stateholding[sh_idx].st[0]) > 0) {
 	    fprintf (_lfp, "+");
 	  }
-	  first = 0;
-	  a->mfprintf (_lfp, "%s", buf);
+	  fputs (outpin, _lfp);
 	  fprintf (_lfp, "*!(");
-	  first = 1;
-	  for (int i=0; i < (1 << _num_inputs); i++) {
-	    if (bitset_tst (_stateholding[sh_idx].st[1], i)) {
-	      if (!first) {
-		fprintf (_lfp, "+");
-	      }
-	      first = 0;
-	      _print_input_case (i);
-	    }
-	  }
+	  _print_sop (_stateholding[sh_idx].st[1]);
 	  fprintf (_lfp, ")");
 	}
       }
@@ -2444,6 +5575,9 @@ void Cell::_emit_dynamic ()
 	       "state-holding");
     }
 
+    /* -- sequential cells: clock-to-output arcs -- */
+    _emit_seq_clk2q (nout);
+
     /* -- measurement results -- 
 
 
@@ -2477,8 +5611,7 @@ void Cell::_emit_dynamic ()
       _l->_tab();
 
       CNLFP (_lfp, "related_pin: \"");
-      _sprint_input_pin (buf, 1024, dyn[i].in_id);
-      a->mfprintf (_lfp, "%s", buf);
+      fputs (_lib_pin (dyn[i].in_id), _lfp);
       fprintf (_lfp, "\";\n");
 
       idx_case = dyn[i].idx[dyn[i].nidx-1];
@@ -2504,12 +5637,8 @@ void Cell::_emit_dynamic ()
 	    fprintf (_lfp, ", ");
 	  }
 	  /*-- XXX: fixme: units, internal power definition --*/
-	  dp = dyn[i].intpow[j + k*nslew];
-	  dp = dp - leakage_power[idx_case];
-	  /* internal power is always in fJ */
-	  dp = dp*window*1e-12;	/* picoseconds * power */
-	  dp /= 1e-15;
-	  fprintf (_lfp, "%g", dp);
+	  dp = val[(2*narc + i)*npts + j + k*nslew];
+	  _l->_val (dp);
 	}
 	fprintf (_lfp, "\"");
 	if (j != nslew-1) {
@@ -2531,8 +5660,7 @@ void Cell::_emit_dynamic ()
       _l->_tab();
 
       CNLFP (_lfp, "related_pin: \"");
-      _sprint_input_pin (buf, 1024, dyn[i].in_id);
-      a->mfprintf (_lfp, "%s", buf);
+      fputs (_lib_pin (dyn[i].in_id), _lfp);
       fprintf (_lfp, "\";\n");
 
       if (dyn[i].in_init == dyn[i].out_init) {
@@ -2567,14 +5695,13 @@ void Cell::_emit_dynamic ()
 	    fprintf (_lfp, ", ");
 	  }
 	  /*-- XXX: fixme: units, internal power definition --*/
-	  dp = dyn[i].delay[j+k*nslew];
-	  dp /= config_get_real ("xcell.units.time_conv");
+	  dp = val[i*npts + j + k*nslew];
 #if 0	  
 	  if (dp < 0) {
 	    dp = 0;
 	  }
 #endif	  
-	  fprintf (_lfp, "%g", dp);
+	  _l->_val (dp);
 	}
 	fprintf (_lfp, "\"");
 	if (j != nslew-1) {
@@ -2588,6 +5715,8 @@ void Cell::_emit_dynamic ()
       _l->_untab();
       CNLFP (_lfp, "}\n");
 
+      _emit_mc_sigma (i, 0);
+
       /* -- transition time -- */
 
       CNLFP (_lfp, "%s_transition(delay_%dx%d) {\n",
@@ -2606,9 +5735,8 @@ void Cell::_emit_dynamic ()
 	    fprintf (_lfp, ", ");
 	  }
 	  /*-- XXX: fixme: units, internal power definition --*/
-	  dp = dyn[i].transit[j+k*nslew];
-	  dp /= config_get_real ("xcell.units.time_conv");
-	  fprintf (_lfp, "%g", dp);
+	  dp = val[(narc + i)*npts + j + k*nslew];
+	  _l->_val (dp);
 	}
 	fprintf (_lfp, "\"");
 	if (j != nslew-1) {
@@ -2622,6 +5750,9 @@ void Cell::_emit_dynamic ()
       _l->_untab();
       CNLFP (_lfp, "}\n");
 
+      _emit_mc_sigma (i, 1);
+      _emit_ccs (i);
+
       
       _l->_untab();
       CNLFP (_lfp, "}\n");
@@ -2630,12 +5761,120 @@ void Cell::_emit_dynamic ()
     _l->_untab ();
     CNLFP (_lfp, "}\n");
   }
+  if (val) {
+    FREE (val);
+  }
+}
+
+
+
+/*-- CCS output current vectors of arc idx --*/
+void Cell::_emit_ccs (int idx)
+{
+  int nslew = config_get_table_size ("xcell.input_trans");
+  int nsweep = config_get_table_size ("xcell.load");
+  double tconv = config_get_real ("xcell.units.time_conv");
+  double iconv = config_get_real ("xcell.units.current_conv");
+
+  if (!dyn[idx].ccs) return;
+
+  CNLFP (_lfp, "output_current_%s() {\n",
+	 dyn[idx].out_init == 0 ? "rise" : "fall");
+  _l->_tab();
+  for (int j=0; j < nslew; j++) {
+    for (int k=0; k < nsweep; k++) {
+      struct ccs_wave *w = &dyn[idx].ccs[j + k*nslew];
+      if (w->n == 0) continue;
+
+      CNLFP (_lfp, "vector(ccs_template) {\n");
+      _l->_tab();
+      CNLFP (_lfp, "reference_time : %g;\n", w->ref/tconv);
+      CNLFP (_lfp, "index_1(\"%g\");\n", _l->_trans[j]);
+      CNLFP (_lfp, "index_2(\"%g\");\n", _l->_load[k]);
+      CNLFP (_lfp, "index_3(\"");
+      for (int m=0; m < w->n; m++) {
+	fprintf (_lfp, "%s", m == 0 ? "" : ", ");
+	_l->_val (w->t[m]/tconv);
+      }
+      fprintf (_lfp, "\");\n");
+      CNLFP (_lfp, "values(\"");
+      for (int m=0; m < w->n; m++) {
+	fprintf (_lfp, "%s", m == 0 ? "" : ", ");
+	_l->_val (w->i[m]/iconv);
+      }
+      fprintf (_lfp, "\");\n");
+      _l->_untab();
+      CNLFP (_lfp, "}\n");
+    }
+  }
+  _l->_untab();
+  CNLFP (_lfp, "}\n");
+}
+
+
+/*-- LVF sigma table for the delay (which = 0) or transition (which = 1)
+  of arc idx --*/
+void Cell::_emit_mc_sigma (int idx, int which)
+{
+  int nslew = config_get_table_size ("xcell.input_trans");
+  int nsweep = config_get_table_size ("xcell.load");
+  const char *dir = dyn[idx].out_init == 0 ? "rise" : "fall";
+  double *sig;
+
+  if (!dyn[idx].mc) return;
+
+  if (which == 0) {
+    CNLFP (_lfp, "ocv_sigma_cell_%s(delay_%dx%d) {\n", dir, nslew, nsweep);
+  }
+  else {
+    CNLFP (_lfp, "ocv_sigma_%s_transition(delay_%dx%d) {\n", dir,
+	   nslew, nsweep);
+  }
+  _l->_tab();
+  CNLFP (_lfp, "sigma_type : early_and_late;\n");
+  _l->dump_index_tables ();
+
+  MALLOC (sig, double, nslew*nsweep);
+  for (int j=0; j < nslew*nsweep; j++) {
+    sig[j] = mc_sigma (&dyn[idx].mc[5*j], which);
+  }
+  _emit_table_values (sig, nslew, nsweep,
+		      1/config_get_real ("xcell.units.time_conv"));
+  FREE (sig);
+
+  _l->_untab();
+  CNLFP (_lfp, "}\n");
 }
 
 
+/*-- pin name as printed in the .lib, mangled once per cell --*/
+const char *Cell::_lib_pin (int pos)
+{
+  if (!_lib_pins) {
+    char buf[1024];
+    char mbuf[1024];
+    
+    MALLOC (_lib_pins, char *, _num_inputs + _num_outputs);
+    for (int i=0; i < _num_inputs + _num_outputs; i++) {
+      if (i < _num_inputs) {
+	_sprint_input_pin (buf, 1024, i);
+      }
+      else {
+	_sprint_output_pin (buf, 1024, i - _num_inputs);
+      }
+      a->msnprintf (mbuf, 1024, "%s", buf);
+      _lib_pins[i] = Strdup (mbuf);
+    }
+  }
+  return _lib_pins[pos];
+}
 
 void Cell::_sprint_input_pin (char *buf, int sz, int pos)
 {
+  if (_pin_names) {
+    snprintf (buf, sz, "%s", _pin_names[pos]);
+    return;
+  }
   int i = _get_input_pin (pos);
   ActId *tmp = nl->bN->ports[i].c->toid();
   tmp->sPrint (buf, sz);
@@ -2648,6 +5887,10 @@ void Cell::_sprint_input_pin (char *buf, int sz, int pos)
 
 void Cell::_sprint_output_pin (char *buf, int sz, int pos)
 {
+  if (_pin_names) {
+    snprintf (buf, sz, "%s", _pin_names[_num_inputs + pos]);
+    return;
+  }
   int i = _get_output_pin (pos);
   ActId *tmp = nl->bN->ports[i].c->toid();
   tmp->sPrint (buf, sz);
@@ -2683,28 +5926,29 @@ int Cell::_run_dflow_dynamic (void)
       A_NEXT (dyn).in_id = i;
       A_NEXT (dyn).in_init = 1;
       A_NEXT (dyn).out_init = 1;
+      A_NEXT (dyn).scen = -1;
+      A_NEXT (dyn).mc = NULL;
+      A_NEXT (dyn).ccs = NULL;
+      A_INC (dyn);
+    }
+  }
 
-      MALLOC (A_NEXT (dyn).delay, double, nslew*nsweep);
-      MALLOC (A_NEXT (dyn).transit, double, nslew*nsweep);
-      MALLOC (A_NEXT (dyn).intpow, double, nslew*nsweep);
-
-      _sprint_output_pin (pbuf, 200, j);
+  _arc_tab = _alloc_arc_tables (nslew*nsweep);
+  for (int i=0; i < A_LEN (dyn); i++) {
+    _sprint_output_pin (pbuf, 200, dyn[i].out_id);
 
-      double d;
-      snprintf (cbuf, 1024, "xcell.dflow.%s.%s.delay", _p->getName(), pbuf);
-      if (config_exists (cbuf)) {
-	d = config_get_real (cbuf);
-      }
-      else {
-	d = 0;
-      }
+    double d;
+    snprintf (cbuf, 1024, "xcell.dflow.%s.%s.delay", _p->getName(), pbuf);
+    if (config_exists (cbuf)) {
+      d = config_get_real (cbuf);
+    }
+    else {
+      d = 0;
+    }
 
-      for (int k=0; k < nslew*nsweep; k++) {
-	A_NEXT (dyn).delay[k] = d;
-	A_NEXT (dyn).transit[k] = 10e-12;
-	A_NEXT (dyn).intpow[k] = 0.0;
-      }
-      A_INC (dyn);
+    for (int k=0; k < nslew*nsweep; k++) {
+      dyn[i].delay[k] = d;
+      dyn[i].transit[k] = 10e-12;
     }
   }
   
@@ -2750,3 +5994,626 @@ void Cell::_dump_dynamic (int idx)
   }
   printf ("\n");
 }
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Micro-benchmarks of the kernels that grow with the number of
+ *  inputs: truth tables, pull-up/pull-down evaluation, arc
+ *  generation, the driven-assignment search, measurement parsing, and
+ *  the leakage/function emitters. Truth tables come from the
+ *  production rules and all tables are zero, so no simulator is
+ *  needed. Library output goes to /dev/null.
+ *
+ *------------------------------------------------------------------------
+ */
+void Cell::microbench ()
+{
+  int nslew = config_get_table_size ("xcell.input_trans");
+  int nsweep = config_get_table_size ("xcell.load");
+  const char *name = _p->getName();
+  unsigned int nvec;
+  volatile int sink = 0;
+  char buf[1024];
+  FILE *fp;
+
+  if (!nl || _is_dataflow || (_is_external && _ext_type)) {
+    return;
+  }
+  nvec = (1U << _num_inputs);
+
+  /*-- truth tables --*/
+  mb_begin (name, "truth_table", _num_inputs);
+  while (mb_iter ()) {
+    _free_outvals ();
+    _logic_outvals ();
+  }
+
+  /*-- pull-up/pull-down of the state-holding gates --*/
+  if (_num_stateholding > 0) {
+    mb_begin (name, "sh_inputs", _num_inputs);
+    while (mb_iter ()) {
+      for (int i=0; i < _num_stateholding; i++) {
+	for (int k=0; k < 2; k++) {
+	  if (_stateholding[i].st[k]) {
+	    bitset_free (_stateholding[i].st[k]);
+	    _stateholding[i].st[k] = NULL;
+	  }
+	}
+      }
+      _calc_sh_inputs ();
+    }
+  }
+
+  /*-- dynamic arcs; the dynamic cases have no tables yet, and the
+    scenarios are rebuilt from the last run --*/
+  mb_begin (name, "calc_dynamic", _num_inputs);
+  while (mb_iter ()) {
+    A_FREE (dyn);
+    A_INIT (dyn);
+    A_FREE (dscen);
+    A_INIT (dscen);
+    if (_is_out) {
+      FREE (_is_out);
+      _is_out = NULL;
+    }
+    _calc_dynamic ();
+  }
+  _calc_scenarios ();
+
+  /*-- search for a vector that drives a state-holding gate, for every
+    (vector, input) pair that _calc_dynamic might ask about --*/
+  if (_num_stateholding > 0) {
+    mb_begin (name, "driven_assignment", _num_inputs);
+    while (mb_iter ()) {
+      for (int sv=0; sv < _num_stateholding; sv++) {
+	struct stateholding_info *shi = &_stateholding[sv];
+	for (int drive_up=0; drive_up < 2; drive_up++) {
+	  for (unsigned int i=0; i < nvec; i++) {
+	    if (!bitset_tst (shi->st[drive_up], i)) continue;
+	    for (int j=0; j < _num_inputs; j++) {
+	      sink += find_driven_assignment (shi->st[1-drive_up],
+					      shi->st[drive_up],
+					      _num_inputs, j,
+					      (1-((i >> j) & 1)), i);
+	    }
+	  }
+	}
+      }
+    }
+  }
+
+  /*-- measurement file of the size the dynamic run produces --*/
+  snprintf (buf, 1024, "_spmb_");
+  a->msnprintfproc (buf + 6, 1018, _p);
+  snprintf (buf + strlen (buf), 1024 - strlen (buf), ".mt0");
+  fp = fopen (buf, "w");
+  if (!fp) {
+    fatal_error ("Could not open `%s' for writing", buf);
+  }
+  for (int l=0; l < nsweep; l++) {
+    for (int j=0; j < A_LEN (dyn); j++) {
+      for (int ns=0; ns < nslew; ns++) {
+	fprintf (fp, "delay_%d_%d = %g\n", j, ns, 1e-11*(1 + l + ns));
+	fprintf (fp, "negdelay_%d_%d = -1\n", j, ns);
+	fprintf (fp, "transit_%d_%d = %g\n", j, ns, 1e-11*(2 + l + ns));
+	fprintf (fp, "intpow_%d_%d = %g\n", j, ns, -1e-6*(1 + l));
+      }
+    }
+    fprintf (fp, "load = %g\n", 1e-15*(l+1));
+  }
+  fclose (fp);
+
+  mb_begin (name, "parse_measurements", _num_inputs);
+  while (mb_iter ()) {
+    for (int l=0; l < nsweep; l++) {
+      struct Hashtable *H = parse_measurements (buf, "load", l);
+      sink += H->n;
+      hash_free (H);
+    }
+  }
+  unlink (buf);
+
+  /*-- emitters, with zero tables --*/
+  if (!leakage_power) {
+    MALLOC (leakage_power, double, nvec);
+    for (unsigned int i=0; i < nvec; i++) {
+      leakage_power[i] = 0;
+    }
+  }
+  _arc_tab = _alloc_arc_tables (nslew*nsweep);
+  for (int i=0; i < A_LEN (dyn); i++) {
+    dyn[i].mc = NULL;
+    dyn[i].ccs = NULL;
+  }
+
+  FILE *save = _lfp;
+  _lfp = fopen ("/dev/null", "w");
+  if (!_lfp) {
+    fatal_error ("Could not open /dev/null");
+  }
+  _l->_lfp = _lfp;
+
+  mb_begin (name, "emit_leakage", _num_inputs);
+  while (mb_iter ()) {
+    _emit_leakage ();
+  }
+  mb_begin (name, "emit_dynamic", _num_inputs);
+  while (mb_iter ()) {
+    _emit_dynamic ();
+  }
+
+  fclose (_lfp);
+  _lfp = save;
+  _l->_lfp = save;
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Characterization database. save() writes everything the emitters
+ *  use; the database constructor rebuilds those members, so that
+ *  emit() regenerates the same library without the netlist.
+ *
+ *------------------------------------------------------------------------
+ */
+static uint64_t put_bitsets (struct chardb_writer *w, bitset_t **b, int n,
+			     int nin)
+{
+  unsigned long nw = CHARDB_WORDS (nin);
+  uint64_t *words;
+  uint64_t off;
+
+  if (n == 0 || !b) {
+    return 0;
+  }
+  MALLOC (words, uint64_t, n*nw);
+  memset (words, 0, sizeof (uint64_t)*n*nw);
+  for (int i=0; i < n; i++) {
+    if (!b[i]) continue;
+    for (unsigned int v=0; v < (1U << nin); v++) {
+      if (bitset_tst (b[i], v)) {
+	words[i*nw + (v >> 6)] |= ((uint64_t)1 << (v & 63));
+      }
+    }
+  }
+  off = chardb_put (w, words, sizeof (uint64_t)*n*nw);
+  FREE (words);
+  return off;
+}
+
+static bitset_t *get_bitset (struct chardb *db, uint64_t off, int k, int nin)
+{
+  unsigned long nw = CHARDB_WORDS (nin);
+  const uint64_t *words;
+  bitset_t *b;
+
+  words = (const uint64_t *) chardb_ptr (db, off, sizeof (uint64_t)*(k+1)*nw);
+  if (!words) {
+    return NULL;
+  }
+  words += k*nw;
+  b = bitset_new (1 << nin);
+  bitset_clear (b);
+  for (unsigned int v=0; v < (1U << nin); v++) {
+    if ((words[v >> 6] >> (v & 63)) & 1) {
+      bitset_set (b, v);
+    }
+  }
+  return b;
+}
+
+static uint64_t put_ints (struct chardb_writer *w, int *x, int n)
+{
+  int32_t *v;
+  uint64_t off;
+
+  if (!x || n == 0) {
+    return 0;
+  }
+  MALLOC (v, int32_t, n);
+  for (int i=0; i < n; i++) {
+    v[i] = x[i];
+  }
+  off = chardb_put (w, v, sizeof (int32_t)*n);
+  FREE (v);
+  return off;
+}
+
+static int *get_ints (struct chardb *db, uint64_t off, int n)
+{
+  const int32_t *v = (const int32_t *) chardb_ptr (db, off, sizeof (int32_t)*n);
+  int *x;
+
+  if (!v) {
+    return NULL;
+  }
+  MALLOC (x, int, n);
+  for (int i=0; i < n; i++) {
+    x[i] = v[i];
+  }
+  return x;
+}
+
+/*-- indices of an arc record that the emitters use unchecked --*/
+static int arc_in_range (const struct chardb_arc *a, int nin, int nout)
+{
+  if (a->nidx < 0 || a->nidx > 4 || a->nshare < 0 ||
+      a->in_id < 0 || a->in_id >= nin || a->out_id < 0 ||
+      a->out_id >= nout || (a->in_init & ~1) || (a->out_init & ~1)) {
+    return 0;
+  }
+  for (int k=0; k < a->nidx; k++) {
+    if (a->idx[k] < 0 || a->idx[k] >= (1 << nin)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static double *get_doubles (struct chardb *db, uint64_t off, int n)
+{
+  const double *v = (const double *) chardb_ptr (db, off, sizeof (double)*n);
+  double *x;
+
+  if (!v) {
+    return NULL;
+  }
+  MALLOC (x, double, n);
+  memcpy (x, v, sizeof (double)*n);
+  return x;
+}
+
+
+void Cell::save (struct chardb_writer *w)
+{
+  int nslew = config_get_table_size ("xcell.input_trans");
+  int nsweep = config_get_table_size ("xcell.load");
+  int npts = nslew*nsweep;
+  int nstr = _num_inputs + _num_outputs;
+  struct chardb_cell c;
+  uint64_t *offs;
+  char buf[1024];
+
+  if (!nl) {
+    return;
+  }
+
+  memset (&c, 0, sizeof (c));
+  a->msnprintfproc (buf, 1024, _p);
+  c.name = chardb_put_str (w, buf);
+  c.cfg = chardb_put_str (w, _cellinfo (_p));
+  c.ninputs = _num_inputs;
+  c.noutputs = _num_outputs;
+  c.nint = _outvals ? _num_outvals - _num_outputs : 0;
+  c.nsh = _num_stateholding;
+  c.clock_pin = _clock_pin;
+  c.flags = (_is_dataflow ? CHARDB_DATAFLOW : 0) |
+    (_sparse ? CHARDB_SPARSE : 0) | (_ext_type << CHARDB_EXT_SHIFT);
+
+  /*-- pin names and function overrides --*/
+  MALLOC (offs, uint64_t, nstr);
+  for (int i=0; i < nstr; i++) {
+    if (i < _num_inputs) {
+      _sprint_input_pin (buf, 1024, i);
+    }
+    else {
+      _sprint_output_pin (buf, 1024, i - _num_inputs);
+    }
+    offs[i] = chardb_put_str (w, buf);
+  }
+  c.in_names = chardb_put (w, offs, sizeof (uint64_t)*_num_inputs);
+  c.out_names = chardb_put (w, offs + _num_inputs,
+			    sizeof (uint64_t)*_num_outputs);
+  if (fn_override) {
+    for (int i=0; i < _num_outputs; i++) {
+      offs[i] = chardb_put_str (w, fn_override[i]);
+    }
+    c.fn = chardb_put (w, offs, sizeof (uint64_t)*_num_outputs);
+  }
+  FREE (offs);
+
+  /*-- truth tables --*/
+  c.truth = put_bitsets (w, _outvals, _num_outvals, _num_inputs);
+  if (_num_stateholding > 0) {
+    bitset_t **st;
+    MALLOC (st, bitset_t *, 2*_num_stateholding);
+    for (int i=0; i < _num_stateholding; i++) {
+      st[2*i] = _stateholding[i].st[0];
+      st[2*i+1] = _stateholding[i].st[1];
+    }
+    c.sh = put_bitsets (w, st, 2*_num_stateholding, _num_inputs);
+    FREE (st);
+  }
+  c.is_out = put_ints (w, _is_out, _num_outputs);
+  c.seq_inv = put_ints (w, _seq_inv, _num_outputs);
+
+  /*-- leakage and input capacitance --*/
+  c.leak = chardb_put (w, leakage_power,
+		       sizeof (double)*(1 << _num_inputs));
+  if (_leak_sampled) {
+    c.leak_sampled = put_bitsets (w, &_leak_sampled, 1, _num_inputs);
+  }
+  if (time_up && time_dn) {
+    double *cap;
+    MALLOC (cap, double, 2*_num_inputs);
+    for (int i=0; i < _num_inputs; i++) {
+      cap[i] = time_up[i];
+      cap[_num_inputs + i] = time_dn[i];
+    }
+    c.cap = chardb_put (w, cap, sizeof (double)*2*_num_inputs);
+    FREE (cap);
+  }
+
+  /*-- arcs: the table block is written as is --*/
+  if (A_LEN (dyn) > 0 && _arc_tab) {
+    struct chardb_arc *arc;
+
+    c.narcs = A_LEN (dyn);
+    c.tables = chardb_put (w, _arc_tab, sizeof (double)*3*c.narcs*npts);
+    MALLOC (arc, struct chardb_arc, c.narcs);
+    memset (arc, 0, sizeof (struct chardb_arc)*c.narcs);
+    for (int i=0; i < c.narcs; i++) {
+      arc[i].nidx = dyn[i].nidx;
+      for (int k=0; k < 4; k++) {
+	arc[i].idx[k] = dyn[i].idx[k];
+      }
+      arc[i].out_id = dyn[i].out_id;
+      arc[i].in_id = dyn[i].in_id;
+      arc[i].in_init = dyn[i].in_init;
+      arc[i].out_init = dyn[i].out_init;
+      arc[i].nshare = dyn[i].scen >= 0 ? dscen[dyn[i].scen].narcs : 0;
+      arc[i].mc = chardb_put (w, dyn[i].mc, sizeof (double)*5*npts);
+      if (dyn[i].ccs) {
+	struct chardb_wave *wv;
+	MALLOC (wv, struct chardb_wave, npts);
+	memset (wv, 0, sizeof (struct chardb_wave)*npts);
+	for (int j=0; j < npts; j++) {
+	  wv[j].n = dyn[i].ccs[j].n;
+	  if (wv[j].n == 0) continue;
+	  wv[j].ref = dyn[i].ccs[j].ref;
+	  wv[j].t = chardb_put (w, dyn[i].ccs[j].t, sizeof (double)*wv[j].n);
+	  wv[j].i = chardb_put (w, dyn[i].ccs[j].i, sizeof (double)*wv[j].n);
+	}
+	arc[i].ccs = chardb_put (w, wv, sizeof (struct chardb_wave)*npts);
+	FREE (wv);
+      }
+    }
+    c.arcs = chardb_put (w, arc, sizeof (struct chardb_arc)*c.narcs);
+    FREE (arc);
+  }
+
+  /*-- sequential arcs --*/
+  if (A_LEN (seq) > 0) {
+    struct chardb_seq *sq;
+
+    c.nseq = A_LEN (seq);
+    MALLOC (sq, struct chardb_seq, c.nseq);
+    memset (sq, 0, sizeof (struct chardb_seq)*c.nseq);
+    for (int i=0; i < c.nseq; i++) {
+      int n = (seq[i].type == SEQ_CLK2Q ? npts : nslew*nslew);
+      sq[i].type = seq[i].type;
+      sq[i].pin = seq[i].pin;
+      sq[i].dir = seq[i].dir;
+      sq[i].val = chardb_put (w, seq[i].val, sizeof (double)*n);
+      sq[i].transit = chardb_put (w, seq[i].transit, sizeof (double)*n);
+    }
+    c.seq = chardb_put (w, sq, sizeof (struct chardb_seq)*c.nseq);
+    FREE (sq);
+  }
+
+  chardb_add_cell (w, &c);
+}
+
+
+Cell::Cell (Liberty *l, struct chardb *db, const struct chardb_cell *c)
+{
+  int nslew = config_get_table_size ("xcell.input_trans");
+  int nsweep = config_get_table_size ("xcell.load");
+  int npts = nslew*nsweep;
+  const uint64_t *names;
+  const char *str;
+
+  _init (l);
+
+  str = chardb_str (db, c->name);
+  if (!str) {
+    fatal_error ("%s: corrupt cell record", db->file);
+  }
+  _db_name = Strdup (str);
+  str = chardb_str (db, c->cfg);
+  _db_cfg = Strdup (str ? str : "");
+
+  _num_inputs = c->ninputs;
+  _num_outputs = c->noutputs;
+  _is_dataflow = (c->flags & CHARDB_DATAFLOW) ? 1 : 0;
+  _sparse = (c->flags & CHARDB_SPARSE) ? 1 : 0;
+  _ext_type = (c->flags >> CHARDB_EXT_SHIFT) & 0x7;
+  _is_external = _ext_type ? 1 : 0;
+  _clock_pin = c->clock_pin;
+
+  if (_num_inputs < 1 || _num_inputs > 24 || _num_outputs < 1) {
+    fatal_error ("%s: cell `%s' has a bad pin count", db->file, _db_name);
+  }
+  if (c->nint < 0 || c->nsh < 0 || c->narcs < 0 || c->nseq < 0 ||
+      c->clock_pin < -1 || c->clock_pin >= _num_inputs) {
+    fatal_error ("%s: cell `%s' has a corrupt record", db->file, _db_name);
+  }
+
+  /*-- pin names, and function overrides --*/
+  MALLOC (_pin_names, char *, _num_inputs + _num_outputs);
+  for (int i=0; i < _num_inputs + _num_outputs; i++) {
+    if (i < _num_inputs) {
+      names = (const uint64_t *)
+	chardb_ptr (db, c->in_names, sizeof (uint64_t)*_num_inputs);
+      str = names ? chardb_str (db, names[i]) : NULL;
+    }
+    else {
+      names = (const uint64_t *)
+	chardb_ptr (db, c->out_names, sizeof (uint64_t)*_num_outputs);
+      str = names ? chardb_str (db, names[i - _num_inputs]) : NULL;
+    }
+    if (!str) {
+      fatal_error ("%s: cell `%s' is missing pin names", db->file, _db_name);
+    }
+    _pin_names[i] = Strdup (str);
+  }
+  names = (const uint64_t *)
+    chardb_ptr (db, c->fn, sizeof (uint64_t)*_num_outputs);
+  if (names) {
+    MALLOC (fn_override, char *, _num_outputs);
+    for (int i=0; i < _num_outputs; i++) {
+      str = chardb_str (db, names[i]);
+      fn_override[i] = str ? Strdup (str) : NULL;
+    }
+  }
+
+  /*-- truth tables --*/
+  if (c->truth) {
+    _num_outvals = _num_outputs + c->nint;
+    MALLOC (_outvals, bitset_t *, _num_outvals);
+    for (int i=0; i < _num_outvals; i++) {
+      _outvals[i] = get_bitset (db, c->truth, i, _num_inputs);
+      if (!_outvals[i]) {
+	fatal_error ("%s: cell `%s' has corrupt truth tables", db->file,
+		     _db_name);
+      }
+    }
+  }
+  if (c->nsh > 0) {
+    _num_stateholding = c->nsh;
+    MALLOC (_stateholding, struct stateholding_info, _num_stateholding);
+    for (int i=0; i < _num_stateholding; i++) {
+      _stateholding[i].n = NULL;
+      for (int k=0; k < 2; k++) {
+	_stateholding[i].tt[k] = NULL;
+	_stateholding[i].prog[k] = NULL;
+	_stateholding[i].st[k] = get_bitset (db, c->sh, 2*i+k, _num_inputs);
+      }
+    }
+  }
+  _is_out = get_ints (db, c->is_out, _num_outputs);
+  _seq_inv = get_ints (db, c->seq_inv, _num_outputs);
+  for (int i=0; _is_out && i < _num_outputs; i++) {
+    /* 0, or +/-(1 + state-holding gate) */
+    if (_is_out[i] < -_num_stateholding || _is_out[i] > _num_stateholding) {
+      fatal_error ("%s: cell `%s' has corrupt output info", db->file,
+		   _db_name);
+    }
+  }
+
+  /*-- leakage and input capacitance --*/
+  leakage_power = get_doubles (db, c->leak, 1 << _num_inputs);
+  if (!leakage_power) {
+    MALLOC (leakage_power, double, 1 << _num_inputs);
+    for (int i=0; i < (1 << _num_inputs); i++) {
+      leakage_power[i] = 0;
+    }
+  }
+  if (c->leak_sampled) {
+    _leak_sampled = get_bitset (db, c->leak_sampled, 0, _num_inputs);
+  }
+  double *cap = get_doubles (db, c->cap, 2*_num_inputs);
+  MALLOC (time_up, double, _num_inputs);
+  MALLOC (time_dn, double, _num_inputs);
+  for (int i=0; i < _num_inputs; i++) {
+    time_up[i] = cap ? cap[i] : 0;
+    time_dn[i] = cap ? cap[_num_inputs + i] : 0;
+  }
+  if (cap) {
+    FREE (cap);
+  }
+
+  /*-- arcs; every arc that shares a scenario gets its own, with the
+    same number of arcs sharing it --*/
+  const struct chardb_arc *arc = (const struct chardb_arc *)
+    chardb_ptr (db, c->arcs, sizeof (struct chardb_arc)*c->narcs);
+  const double *tab = (const double *)
+    chardb_ptr (db, c->tables, sizeof (double)*3*c->narcs*npts);
+  if (c->narcs > 0 && (!arc || !tab)) {
+    fatal_error ("%s: cell `%s' has corrupt arcs", db->file, _db_name);
+  }
+  for (int i=0; i < c->narcs; i++) {
+    if (!arc_in_range (&arc[i], _num_inputs, _num_outputs)) {
+      fatal_error ("%s: cell `%s' arc %d is out of range", db->file,
+		   _db_name, i);
+    }
+    A_NEW (dyn, struct dynamic_case);
+    A_NEXT (dyn).nidx = arc[i].nidx;
+    for (int k=0; k < 4; k++) {
+      A_NEXT (dyn).idx[k] = arc[i].idx[k];
+    }
+    A_NEXT (dyn).out_id = arc[i].out_id;
+    A_NEXT (dyn).in_id = arc[i].in_id;
+    A_NEXT (dyn).in_init = arc[i].in_init;
+    A_NEXT (dyn).out_init = arc[i].out_init;
+    A_NEXT (dyn).scen = -1;
+    if (arc[i].nshare > 0) {
+      A_NEW (dscen, struct dynamic_scenario);
+      A_NEXT (dscen).nidx = 0;
+      A_NEXT (dscen).narcs = arc[i].nshare;
+      A_NEXT (dscen).skip = 0;
+      A_NEXT (dscen).user = 0;
+      A_NEXT (dyn).scen = A_LEN (dscen);
+      A_INC (dscen);
+    }
+    A_NEXT (dyn).mc = get_doubles (db, arc[i].mc, 5*npts);
+    A_NEXT (dyn).ccs = NULL;
+    const struct chardb_wave *wv = (const struct chardb_wave *)
+      chardb_ptr (db, arc[i].ccs, sizeof (struct chardb_wave)*npts);
+    if (wv) {
+      MALLOC (A_NEXT (dyn).ccs, struct ccs_wave, npts);
+      for (int j=0; j < npts; j++) {
+	struct ccs_wave *x = &A_NEXT (dyn).ccs[j];
+	x->n = wv[j].n;
+	x->ref = wv[j].ref;
+	if (x->n < 0) {
+	  fatal_error ("%s: cell `%s' has corrupt CCS data", db->file,
+		       _db_name);
+	}
+	if (x->n > 0) {
+	  x->t = get_doubles (db, wv[j].t, x->n);
+	  x->i = get_doubles (db, wv[j].i, x->n);
+	  if (!x->t || !x->i) {
+	    fatal_error ("%s: cell `%s' has corrupt CCS data", db->file,
+			 _db_name);
+	  }
+	}
+      }
+    }
+    A_INC (dyn);
+  }
+  if (c->narcs > 0) {
+    _arc_tab = _alloc_arc_tables (npts);
+    memcpy (_arc_tab, tab, sizeof (double)*3*c->narcs*npts);
+  }
+
+  /*-- sequential arcs --*/
+  const struct chardb_seq *sq = (const struct chardb_seq *)
+    chardb_ptr (db, c->seq, sizeof (struct chardb_seq)*c->nseq);
+  if (c->nseq > 0 && !sq) {
+    fatal_error ("%s: cell `%s' has corrupt sequential arcs", db->file,
+		 _db_name);
+  }
+  for (int i=0; i < c->nseq; i++) {
+    int n = (sq[i].type == SEQ_CLK2Q ? npts : nslew*nslew);
+    /* clock-to-output arcs are per output, constraints per input */
+    if (sq[i].type < SEQ_SETUP || sq[i].type > SEQ_CLK2Q ||
+	(sq[i].dir & ~1) || sq[i].pin < 0 ||
+	sq[i].pin >= (sq[i].type == SEQ_CLK2Q ? _num_outputs : _num_inputs)) {
+      fatal_error ("%s: cell `%s' sequential arc %d is out of range",
+		   db->file, _db_name, i);
+    }
+    A_NEW (seq, struct seq_arc);
+    A_NEXT (seq).type = sq[i].type;
+    A_NEXT (seq).pin = sq[i].pin;
+    A_NEXT (seq).dir = sq[i].dir;
+    A_NEXT (seq).val = get_doubles (db, sq[i].val, n);
+    A_NEXT (seq).transit = get_doubles (db, sq[i].transit, n);
+    if (!A_NEXT (seq).val) {
+      fatal_error ("%s: cell `%s' has corrupt sequential arcs", db->file,
+		   _db_name);
+    }
+    A_INC (seq);
+  }
+}
@@ -0,0 +1,226 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2021 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <common/misc.h>
+#include "chardb.h"
+
+struct chardb_writer {
+  char *file;
+  FILE *fp;
+  uint64_t pos;
+  struct chardb_header hdr;
+  A_DECL (struct chardb_cell, cells);
+};
+
+static void _pad (struct chardb_writer *w)
+{
+  static const char zero[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+  int n = (8 - (w->pos & 7)) & 7;
+
+  if (n > 0) {
+    fwrite (zero, 1, n, w->fp);
+    w->pos += n;
+  }
+}
+
+struct chardb_writer *chardb_create (const char *file, double vdd,
+				     double window, const double *units,
+				     int ntrans, double *trans,
+				     int nload, double *load)
+{
+  struct chardb_writer *w;
+
+  NEW (w, struct chardb_writer);
+  w->fp = fopen (file, "wb");
+  if (!w->fp) {
+    fatal_error ("Could not open database `%s' for writing", file);
+  }
+  w->file = Strdup (file);
+  A_INIT (w->cells);
+
+  memset (&w->hdr, 0, sizeof (w->hdr));
+  memcpy (w->hdr.magic, CHARDB_MAGIC, 4);
+  w->hdr.version = CHARDB_VERSION;
+  w->hdr.endian = CHARDB_ENDIAN;
+  w->hdr.vdd = vdd;
+  w->hdr.window = window;
+  for (int i=0; i < CHARDB_NUNITS; i++) {
+    w->hdr.units[i] = units[i];
+  }
+  w->hdr.created = time (NULL);
+  fwrite (&w->hdr, sizeof (w->hdr), 1, w->fp);
+  w->pos = sizeof (w->hdr);
+
+  w->hdr.ntrans = ntrans;
+  w->hdr.trans = chardb_put (w, trans, sizeof (double)*ntrans);
+  w->hdr.nload = nload;
+  w->hdr.load = chardb_put (w, load, sizeof (double)*nload);
+  return w;
+}
+
+uint64_t chardb_put (struct chardb_writer *w, const void *data, size_t len)
+{
+  uint64_t off;
+
+  if (!data) {
+    return 0;
+  }
+  _pad (w);
+  off = w->pos;
+  if (len > 0 && fwrite (data, 1, len, w->fp) != len) {
+    fatal_error ("Error writing database `%s'", w->file);
+  }
+  w->pos += len;
+  return off;
+}
+
+uint64_t chardb_put_str (struct chardb_writer *w, const char *s)
+{
+  if (!s) {
+    return 0;
+  }
+  return chardb_put (w, s, strlen (s) + 1);
+}
+
+void chardb_add_cell (struct chardb_writer *w, struct chardb_cell *c)
+{
+  A_NEW (w->cells, struct chardb_cell);
+  A_NEXT (w->cells) = *c;
+  A_INC (w->cells);
+}
+
+void chardb_close (struct chardb_writer *w)
+{
+  w->hdr.ncells = A_LEN (w->cells);
+  w->hdr.cells = chardb_put (w, w->cells,
+			     sizeof (struct chardb_cell)*A_LEN (w->cells));
+  if (A_LEN (w->cells) == 0) {
+    w->hdr.cells = w->pos;
+  }
+  w->hdr.size = w->pos;
+  fseek (w->fp, 0, SEEK_SET);
+  fwrite (&w->hdr, sizeof (w->hdr), 1, w->fp);
+  if (fclose (w->fp) != 0) {
+    fatal_error ("Error writing database `%s'", w->file);
+  }
+  A_FREE (w->cells);
+  FREE (w->file);
+  FREE (w);
+}
+
+
+struct chardb *chardb_open (const char *file)
+{
+  struct chardb *db;
+  struct stat st;
+  void *base;
+  int fd;
+
+  fd = open (file, O_RDONLY);
+  if (fd < 0) {
+    warning ("Could not open database `%s'", file);
+    return NULL;
+  }
+  if (fstat (fd, &st) != 0 || st.st_size < (off_t)sizeof (struct chardb_header)) {
+    warning ("`%s' is not an xcell database", file);
+    close (fd);
+    return NULL;
+  }
+  base = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close (fd);
+  if (base == MAP_FAILED) {
+    warning ("Could not map database `%s'", file);
+    return NULL;
+  }
+
+  NEW (db, struct chardb);
+  db->file = file;
+  db->base = base;
+  db->size = st.st_size;
+  db->hdr = (const struct chardb_header *) base;
+
+  if (memcmp (db->hdr->magic, CHARDB_MAGIC, 4) != 0) {
+    warning ("`%s' is not an xcell database", file);
+  }
+  else if (db->hdr->endian != CHARDB_ENDIAN) {
+    warning ("`%s': database has the wrong byte order", file);
+  }
+  else if (db->hdr->version != CHARDB_VERSION) {
+    warning ("`%s': database version %u, expected %u", file,
+	     db->hdr->version, CHARDB_VERSION);
+  }
+  else if (db->hdr->size != db->size) {
+    warning ("`%s': database is truncated", file);
+  }
+  else {
+    db->cells = (const struct chardb_cell *)
+      chardb_ptr (db, db->hdr->cells,
+		  sizeof (struct chardb_cell)*db->hdr->ncells);
+    if (db->cells || db->hdr->ncells == 0) {
+      return db;
+    }
+    warning ("`%s': corrupt cell index", file);
+  }
+  chardb_free (db);
+  return NULL;
+}
+
+const void *chardb_ptr (struct chardb *db, uint64_t off, size_t len)
+{
+  if (off == 0 || off > db->size || len > db->size - off || (off & 7)) {
+    return NULL;
+  }
+  return (const char *)db->base + off;
+}
+
+const char *chardb_str (struct chardb *db, uint64_t off)
+{
+  const char *s = (const char *) chardb_ptr (db, off, 1);
+
+  if (!s || !memchr (s, '\0', db->size - off)) {
+    return NULL;
+  }
+  return s;
+}
+
+const struct chardb_cell *chardb_find (struct chardb *db, const char *name)
+{
+  for (uint32_t i=0; i < db->hdr->ncells; i++) {
+    const char *s = chardb_str (db, db->cells[i].name);
+    if (s && strcmp (s, name) == 0) {
+      return &db->cells[i];
+    }
+  }
+  return NULL;
+}
+
+void chardb_free (struct chardb *db)
+{
+  munmap (db->base, db->size);
+  FREE (db);
+}
@@ -0,0 +1,172 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2021 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#ifndef __XCELL_CHARDB_H__
+#define __XCELL_CHARDB_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+  Characterization database: everything needed to regenerate the
+  library without the ACT netlist or the simulator.
+
+  The file is a header, a data area, and a cell index at the end.
+  Every field is a fixed-width native integer or double, 8-byte
+  aligned, so the file can be memory-mapped and the records used in
+  place. Variable-sized data (strings, tables) are referred to by
+  byte offsets from the start of the file; 0 means "not present".
+  Strings are NUL-terminated.
+
+  Bitsets over the input vectors (truth tables, pull-up/pull-down) are
+  stored as CHARDB_WORDS(n) uint64_t words, bit v of the table is bit
+  (v & 63) of word (v >> 6).
+
+  Table layouts follow the Cell: an nslew x nload table t is stored
+  with t[slew + load*nslew]. Measurements are in SI units; the index
+  tables are the configuration values they were measured at.
+*/
+#define CHARDB_MAGIC   "XCDB"
+#define CHARDB_VERSION 2
+#define CHARDB_ENDIAN  0x01020304U
+
+#define CHARDB_WORDS(nin)  (((1UL << (nin)) + 63)/64)
+
+/*-- cell flags --*/
+#define CHARDB_DATAFLOW   0x1
+#define CHARDB_SPARSE     0x2
+#define CHARDB_EXT_SHIFT  8	/* external cell type in bits 8..10 */
+
+/*-- xcell.units.<u>_conv values, in this order, in the header --*/
+#define CHARDB_NUNITS  5	/* time, cap, current, power, resis */
+
+struct chardb_header {
+  char magic[4];
+  uint32_t version;
+  uint32_t endian;
+  uint32_t ncells;
+  uint32_t ntrans;		// input transition index table
+  uint32_t nload;		// load index table
+  double vdd;
+  double window;		// xcell.short_window
+  double units[CHARDB_NUNITS];	// unit conversions, see CHARDB_NUNITS
+  uint64_t trans;		// double[ntrans], xcell.input_trans
+  uint64_t load;		// double[nload], xcell.load
+  uint64_t cells;		// struct chardb_cell[ncells]
+  uint64_t size;		// file size
+  int64_t created;		// time_t
+};
+
+struct chardb_cell {
+  uint64_t name;		// name as printed in the .lib
+  uint64_t cfg;			// xcell.cells.<cell> config prefix
+  int32_t ninputs;
+  int32_t noutputs;
+  int32_t nint;			// internal state-holding nodes, whose
+				// truth tables follow the outputs
+  int32_t nsh;			// state-holding gates
+  int32_t narcs;
+  int32_t nseq;
+  int32_t clock_pin;		// sequential cells, else -1
+  uint32_t flags;
+  uint64_t in_names;		// uint64_t[ninputs] strings
+  uint64_t out_names;		// uint64_t[noutputs] strings
+  uint64_t fn;			// uint64_t[noutputs] function overrides
+  uint64_t truth;		// (noutputs+nint) bitsets
+  uint64_t sh;			// nsh x {pull-down, pull-up} bitsets
+  uint64_t is_out;		// int32_t[noutputs]
+  uint64_t seq_inv;		// int32_t[noutputs]
+  uint64_t leak;		// double[2^ninputs], W
+  uint64_t leak_sampled;	// bitset
+  uint64_t cap;			// double[2*ninputs]: rise, then fall; F
+  uint64_t arcs;		// struct chardb_arc[narcs]
+  uint64_t tables;		// double[3*narcs*npts]: all delay tables,
+				// then transition, then internal power
+  uint64_t seq;			// struct chardb_seq[nseq]
+};
+
+struct chardb_arc {
+  int32_t nidx;
+  int32_t idx[4];		// input vectors, idx[nidx-1] is the final one
+  int32_t out_id;
+  int32_t in_id;
+  int32_t in_init;		// 0/1 for rise/fall
+  int32_t out_init;		// 0/1 for rise/fall
+  int32_t nshare;		// arcs sharing its scenario, 0 if none
+  uint64_t mc;			// double[5*npts] Monte Carlo sums
+  uint64_t ccs;			// struct chardb_wave[npts]
+};
+
+struct chardb_wave {
+  int32_t n;
+  int32_t pad;
+  double ref;
+  uint64_t t;			// double[n]
+  uint64_t i;			// double[n]
+};
+
+struct chardb_seq {
+  int32_t type;			// SEQ_SETUP, SEQ_HOLD, SEQ_CLK2Q
+  int32_t pin;
+  int32_t dir;
+  int32_t pad;
+  uint64_t val;			// double[nslew*nslew], or [npts] for clk2q
+  uint64_t transit;		// clk2q: double[npts]
+};
+
+/*
+  Writer: chardb_create writes a placeholder header, with the
+  settings the measurements depend on; data is appended
+  with chardb_put* (each returns the offset it was written at), one
+  cell record is added per chardb_add_cell, and chardb_close writes
+  the index and the final header.
+*/
+struct chardb_writer;
+
+struct chardb_writer *chardb_create (const char *file, double vdd,
+				     double window, const double *units,
+				     int ntrans, double *trans,
+				     int nload, double *load);
+uint64_t chardb_put (struct chardb_writer *w, const void *data, size_t len);
+uint64_t chardb_put_str (struct chardb_writer *w, const char *s);
+void chardb_add_cell (struct chardb_writer *w, struct chardb_cell *c);
+void chardb_close (struct chardb_writer *w);
+
+/*
+  Reader: chardb_open memory-maps and checks a database, returning
+  NULL (with a warning) if it is not a valid one. chardb_ptr returns
+  NULL for offset 0 or if [off, off+len) is not in the file.
+*/
+struct chardb {
+  const char *file;
+  void *base;
+  size_t size;
+  const struct chardb_header *hdr;
+  const struct chardb_cell *cells;
+};
+
+struct chardb *chardb_open (const char *file);
+const void *chardb_ptr (struct chardb *db, uint64_t off, size_t len);
+const char *chardb_str (struct chardb *db, uint64_t off);
+const struct chardb_cell *chardb_find (struct chardb *db, const char *name);
+void chardb_free (struct chardb *db);
+
+#endif /* __XCELL_CHARDB_H__ */
@@ -0,0 +1,232 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2021 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#include <stdio.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <errno.h>
+#include <common/config.h>
+#include <common/misc.h>
+#include "jobs.h"
+#include "progress.h"
+
+struct job_info {
+  pid_t pid;			/* -1 once finished */
+  int status;			/* exit status */
+  double cpu;			/* CPU limit (s), 0 if none */
+  double deadline;		/* wall-clock deadline, 0 if none */
+  int killed;			/* killed at the deadline */
+};
+
+struct job_pool {
+  int max;			/* max concurrent jobs */
+  int running;			/* # in flight */
+  A_DECL (struct job_info, job);
+};
+
+struct job_pool *jobs_new (int n)
+{
+  struct job_pool *p;
+
+  NEW (p, struct job_pool);
+  p->max = (n < 1 ? 1 : n);
+  p->running = 0;
+  A_INIT (p->job);
+  return p;
+}
+
+void jobs_free (struct job_pool *p)
+{
+  jobs_wait (p);
+  A_FREE (p->job);
+  FREE (p);
+}
+
+static double _jobs_now ()
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+/*-- kill the jobs past their deadline; returns the earliest deadline
+  of the others, or 0 if none of them has one --*/
+static double _jobs_deadlines (struct job_pool *p)
+{
+  double now = _jobs_now ();
+  double next = 0;
+
+  for (int i=0; i < A_LEN (p->job); i++) {
+    struct job_info *j = &p->job[i];
+    if (j->pid == -1 || j->deadline == 0 || j->killed) continue;
+    if (now >= j->deadline) {
+      /* the job is a process group: the shell and the simulator */
+      kill (-j->pid, SIGKILL);
+      j->killed = 1;
+    }
+    else if (next == 0 || j->deadline < next) {
+      next = j->deadline;
+    }
+  }
+  return next;
+}
+
+/*-- exit status of a job; a simulator killed for CPU time shows up as
+  a SIGXCPU/SIGKILL death, of either it or the shell --*/
+static int _jobs_status (struct job_info *j, int status)
+{
+  int sig = -1;
+
+  if (j->killed) {
+    return JOBS_TIMEOUT;
+  }
+  if (WIFSIGNALED (status)) {
+    sig = WTERMSIG (status);
+  }
+  else if (WIFEXITED (status) && WEXITSTATUS (status) > 128) {
+    sig = WEXITSTATUS (status) - 128;
+  }
+  if (j->cpu > 0 && (sig == SIGXCPU || sig == SIGKILL)) {
+    return JOBS_TIMEOUT;
+  }
+  return WIFEXITED (status) ? WEXITSTATUS (status) : -1;
+}
+
+/*-- reap one finished job of the pool, blocking; the running jobs
+  are polled, so that the ones with a deadline are killed in time --*/
+static void _jobs_reap (struct job_pool *p)
+{
+  int status;
+  pid_t pid;
+
+  /*-- only the pool's own children are waited for, so that other
+    children of the process (e.g. the library compressor) keep their
+    exit status --*/
+  while (1) {
+    double next = _jobs_deadlines (p);
+    for (int i=0; i < A_LEN (p->job); i++) {
+      if (p->job[i].pid <= 0) continue;
+      do {
+	pid = waitpid (p->job[i].pid, &status, WNOHANG);
+      } while (pid == -1 && errno == EINTR);
+      if (pid == -1) {
+	fatal_error ("jobs: waitpid failed (%d running)", p->running);
+      }
+      if (pid == p->job[i].pid) {
+	p->job[i].pid = -1;
+	p->job[i].status = _jobs_status (&p->job[i], status);
+	p->running--;
+	progress_job_done ();
+	return;
+      }
+    }
+    double dt = (next == 0) ? 0.01 : next - _jobs_now ();
+    struct timespec ts;
+    if (dt > 0.01) {
+      dt = 0.01;
+    }
+    if (dt > 0) {
+      ts.tv_sec = 0;
+      ts.tv_nsec = dt*1e9;
+      nanosleep (&ts, NULL);
+    }
+  }
+}
+
+int jobs_submit (struct job_pool *p, const char *cmd)
+{
+  return jobs_submit_limit (p, cmd, 0);
+}
+
+int jobs_submit_limit (struct job_pool *p, const char *cmd, double cpu)
+{
+  pid_t pid;
+
+  progress_job_queued ();
+  while (p->running >= p->max) {
+    _jobs_reap (p);
+  }
+
+  fflush (stdout);
+  fflush (stderr);
+  pid = fork ();
+  if (pid == -1) {
+    fatal_error ("jobs: fork failed");
+  }
+  if (pid == 0) {
+    if (cpu > 0) {
+      struct rlimit rl;
+      setpgid (0, 0);
+      rl.rlim_cur = (rlim_t)cpu + 1;
+      rl.rlim_max = rl.rlim_cur + 1;
+      setrlimit (RLIMIT_CPU, &rl);
+    }
+    execl ("/bin/sh", "sh", "-c", cmd, (char *)NULL);
+    _exit (127);
+  }
+  if (cpu > 0) {
+    /* -- also here, so the group exists before any kill -- */
+    setpgid (pid, pid);
+  }
+
+  A_NEW (p->job, struct job_info);
+  A_NEXT (p->job).pid = pid;
+  A_NEXT (p->job).status = 0;
+  A_NEXT (p->job).cpu = cpu;
+  A_NEXT (p->job).deadline = (cpu > 0) ?
+    _jobs_now () + cpu*config_get_real ("xcell.watchdog.wall_factor") : 0;
+  A_NEXT (p->job).killed = 0;
+  A_INC (p->job);
+  p->running++;
+  progress_job_started ();
+
+  return A_LEN (p->job) - 1;
+}
+
+void jobs_wait (struct job_pool *p)
+{
+  while (p->running > 0) {
+    _jobs_reap (p);
+  }
+}
+
+int jobs_status (struct job_pool *p, int id)
+{
+  Assert (0 <= id && id < A_LEN (p->job), "jobs: bad id");
+  Assert (p->job[id].pid == -1, "jobs: job still running");
+  return p->job[id].status;
+}
+
+int jobs_max ()
+{
+  int n = config_get_int ("xcell.jobs");
+  if (n <= 0) {
+    n = sysconf (_SC_NPROCESSORS_ONLN);
+    if (n <= 0) {
+      n = 1;
+    }
+  }
+  return n;
+}
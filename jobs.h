@@ -0,0 +1,56 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2021 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#ifndef __XCELL_JOBS_H__
+#define __XCELL_JOBS_H__
+
+/*
+  Run shell commands (simulator invocations) concurrently, with at
+  most a fixed number of them in flight at any time.
+
+    jobs_new (n)          : pool with at most n concurrent jobs
+    jobs_submit (p, cmd)  : start "sh -c cmd", waiting for a free slot
+                            first; returns the job id
+    jobs_submit_limit (p, cmd, cpu) : same, but the job (and everything
+                            it starts) is killed once it uses cpu
+                            seconds of CPU time, or runs for
+                            xcell.watchdog.wall_factor times that long;
+                            0 = no limit
+    jobs_wait (p)         : wait until every submitted job has finished
+    jobs_status (p, id)   : exit status of a finished job (-1 if it
+                            did not exit normally, JOBS_TIMEOUT if it
+                            was killed for exceeding its limit)
+*/
+struct job_pool;
+
+#define JOBS_TIMEOUT (-2)
+
+struct job_pool *jobs_new (int n);
+void jobs_free (struct job_pool *p);
+int jobs_submit (struct job_pool *p, const char *cmd);
+int jobs_submit_limit (struct job_pool *p, const char *cmd, double cpu);
+void jobs_wait (struct job_pool *p);
+int jobs_status (struct job_pool *p, int id);
+
+/* number of concurrent jobs from xcell.jobs (0 = number of cpus) */
+int jobs_max ();
+
+#endif /* __XCELL_JOBS_H__ */
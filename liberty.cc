@@ -21,26 +21,124 @@
  */
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <sys/wait.h>
+#if __cplusplus >= 201703L
+#include <charconv>
+#endif
 #include <common/config.h>
 #include <common/misc.h>
 #include "liberty.h"
 
 
+/*-- s in single quotes for the shell; dst has room for len chars --*/
+static void shell_quote (char *dst, int len, const char *s)
+{
+  int i = 0;
+
+  dst[i++] = '\'';
+  for (; *s && i < len - 6; s++) {
+    if (*s == '\'') {
+      /* close the quote, an escaped quote, and reopen */
+      strcpy (dst + i, "'\\''");
+      i += 4;
+    }
+    else {
+      dst[i++] = *s;
+    }
+  }
+  dst[i++] = '\'';
+  dst[i] = '\0';
+}
+
+/*-- a compressor that exits early must not kill us with SIGPIPE;
+  the write error is reported instead --*/
+static void pipe_guard (int on, struct sigaction *save)
+{
+  struct sigaction sa;
+
+  if (on) {
+    sa.sa_handler = SIG_IGN;
+    sigemptyset (&sa.sa_mask);
+    sa.sa_flags = 0;
+    sigaction (SIGPIPE, &sa, save);
+  }
+  else {
+    sigaction (SIGPIPE, save, NULL);
+  }
+}
+
+
 Liberty::Liberty (const char *file)
 {
   char *buf;
 
   _tabs = 0;
+  _out = NULL;
+  _cbuf = NULL;
+  _clen = 0;
+  _index_lines = NULL;
+  _digits = config_get_int ("xcell.lib_digits");
+  _pipe = 0;
+
+  /*-- optionally stream the library through a compressor; it runs
+    as a separate process, so compression overlaps emission --*/
+  const char *z = config_get_string ("xcell.lib_compress");
+  const char *ext = NULL;
   
-  MALLOC (buf, char, strlen (file) + 6);
-  snprintf (buf, strlen (file)+6, "%s.lib", file);
-  
-  _lfp = fopen (buf, "w");
-  if (!_lfp) {
-    fatal_error ("Could not open file `%s' for writing", buf);
+  if (z && *z && strcmp (z, "none") != 0) {
+    if (strcmp (z, "gzip") == 0 || strcmp (z, "pigz") == 0) {
+      ext = ".gz";
+    }
+    else if (strcmp (z, "zstd") == 0) {
+      ext = ".zst";
+    }
+    else {
+      warning ("Unknown lib_compress `%s' (gzip, pigz, or zstd); writing an uncompressed library", z);
+    }
+  }
+  if (ext) {
+    int len = 4*strlen (file) + strlen (z) + 64;
+    char *qf;
+    MALLOC (buf, char, len);
+    MALLOC (qf, char, len);
+    snprintf (buf, len, "command -v %s > /dev/null 2>&1", z);
+    if (system (buf) != 0) {
+      warning ("Compressor `%s' not found; writing an uncompressed library", z);
+      ext = NULL;
+    }
+    else {
+      snprintf (buf, len, "%s.lib%s", file, ext);
+      shell_quote (qf, len, buf);
+      snprintf (buf, len, "%s -c > %s", z, qf);
+      fflush (stdout);
+      fflush (stderr);
+      /*-- close-on-exec, so that simulator jobs do not hold the pipe
+	open --*/
+      _lfp = popen (buf, "we");
+      if (!_lfp) {
+	fatal_error ("Could not run `%s'", buf);
+      }
+      _pipe = 1;
+    }
+    FREE (qf);
+    FREE (buf);
   }
+
+  if (!_pipe) {
+    MALLOC (buf, char, strlen (file) + 6);
+    snprintf (buf, strlen (file)+6, "%s.lib", file);
+  
+    _lfp = fopen (buf, "w");
+    if (!_lfp) {
+      fatal_error ("Could not open file `%s' for writing", buf);
+    }
   
-  FREE (buf);
+    FREE (buf);
+  }
 
   /* -- sanity check units -- */
   double tst;
@@ -181,9 +279,110 @@ Liberty::Liberty (const char *file)
 
 void Liberty::_line()
 {
-  for (int i=0; i < _tabs; i++) {
-    fprintf (_lfp, "   ");
+  static const char sp[] = "                                                ";
+  int n = 3*_tabs;
+
+  while (n > 0) {
+    int k = n < (int)sizeof (sp) - 1 ? n : (int)sizeof (sp) - 1;
+    fwrite (sp, 1, k, _lfp);
+    n -= k;
+  }
+}
+
+void Liberty::_val (double v)
+{
+  char buf[64];
+  int n;
+
+#ifdef __cpp_lib_to_chars
+  std::to_chars_result r;
+  if (_digits > 0) {
+    r = std::to_chars (buf, buf + sizeof (buf), v, std::chars_format::general,
+		       _digits);
+  }
+  else {
+    r = std::to_chars (buf, buf + sizeof (buf), v);
+  }
+  n = r.ptr - buf;
+#else
+  if (_digits > 0) {
+    n = snprintf (buf, sizeof (buf), "%.*g", _digits, v);
+  }
+  else {
+    for (int p=1; p <= 17; p++) {
+      n = snprintf (buf, sizeof (buf), "%.*g", p, v);
+      if (strtod (buf, NULL) == v) break;
+    }
+  }
+#endif
+  fwrite (buf, 1, n, _lfp);
+}
+
+void Liberty::dump_index_tables ()
+{
+  if (!_index_lines) {
+    FILE *tmp = _lfp;
+    size_t len;
+    
+    _lfp = open_memstream (&_index_lines, &len);
+    if (!_lfp) {
+      fatal_error ("Could not allocate the index table buffer");
+    }
+    _dump_index_table (1, _trans_cnt, _trans);
+    fprintf (_lfp, "\n");
+    _dump_index_table (2, _load_cnt, _load);
+    fprintf (_lfp, "\n");
+    fclose (_lfp);
+    _lfp = tmp;
+  }
+  fputs (_index_lines, _lfp);
+}
+
+void Liberty::cell_begin ()
+{
+  Assert (!_out, "Nested cell_begin?");
+  fflush (_lfp);
+  _out = _lfp;
+  _lfp = open_memstream (&_cbuf, &_clen);
+  if (!_lfp) {
+    fatal_error ("Could not allocate the cell buffer");
+  }
+}
+
+void Liberty::cell_end ()
+{
+  char *s;
+  size_t n;
+  struct sigaction save;
+  
+  Assert (_out, "cell_end without cell_begin?");
+  fclose (_lfp);
+  _lfp = _out;
+  _out = NULL;
+
+  s = _cbuf;
+  n = _clen;
+  if (_pipe) {
+    pipe_guard (1, &save);
+  }
+  while (n > 0) {
+    ssize_t k = write (fileno (_lfp), s, n);
+    if (k < 0) {
+      if (errno == EINTR) continue;
+      if (_pipe && errno == EPIPE) {
+	fatal_error ("Library compressor exited early; the library is incomplete");
+      }
+      fatal_error ("Error writing the library file");
+    }
+    s += k;
+    n -= k;
   }
+  if (_pipe) {
+    pipe_guard (0, &save);
+  }
+  free (_cbuf);
+  _cbuf = NULL;
+  _clen = 0;
 }
 
 void Liberty::_tab (void)
@@ -199,10 +398,35 @@ void Liberty::_untab (void)
 
 Liberty::~Liberty()
 {
+  struct sigaction save;
+
+  if (_pipe) {
+    pipe_guard (1, &save);
+  }
   _untab();
   _line ();
-  fprintf (_lfp, "}\n");
-  fclose (_lfp);
+  if (_pipe) {
+    int err, st;
+
+    fprintf (_lfp, "}\n");
+    fflush (_lfp);
+    err = ferror (_lfp);
+    st = pclose (_lfp);
+    pipe_guard (0, &save);
+    if (err) {
+      warning ("Error writing to the library compressor; the library is incomplete");
+    }
+    else if (st == -1 || !WIFEXITED (st) || WEXITSTATUS (st) != 0) {
+      warning ("Library compressor exited with an error (status %d); the library may be incomplete",
+	       (st != -1 && WIFEXITED (st)) ? WEXITSTATUS (st) : -1);
+    }
+  }
+  else {
+    fclose (_lfp);
+  }
+  if (_index_lines) {
+    free (_index_lines);
+  }
 }
 
 
@@ -296,11 +520,42 @@ void Liberty::_lib_emit_header (const char *file)
   /* -- templates -- */
   _lib_emit_template ("lu_table", "delay");
   _lib_emit_template ("power_lut", "power");
+  _lib_emit_template ("lu_table", "constraint");
+  if (config_get_int ("xcell.ccs.enable")) {
+    _lib_emit_template ("output_current", "ccs");
+  }
 }
 
 
 void Liberty::_lib_emit_template (const char *name, const char *prefix)
 {
+  if (strcmp (prefix, "ccs") == 0) {
+    /*-- one vector per slew/load point, indexed by time --*/
+    NLFP (_lfp, "%s_template (%s_template) {\n", name, prefix);
+    _tab();
+    NLFP (_lfp, "variable_1 : input_net_transition;\n");
+    NLFP (_lfp, "variable_2 : total_output_net_capacitance;\n");
+    NLFP (_lfp, "variable_3 : time;\n");
+    _untab();
+    NLFP (_lfp, "}\n");
+    return;
+  }
+  if (strcmp (prefix, "constraint") == 0) {
+    /*-- setup/hold: clock transition x data transition --*/
+    NLFP (_lfp, "%s_template (%s_%dx%d) {\n", name,  prefix,
+	  _trans_cnt, _trans_cnt);
+    _tab();
+    NLFP (_lfp, "variable_1 : related_pin_transition;\n");
+    NLFP (_lfp, "variable_2 : constrained_pin_transition;\n");
+    _dump_index_table (1, _trans_cnt, _trans);
+    fprintf (_lfp, "\n");
+    _dump_index_table (2, _trans_cnt, _trans);
+    fprintf (_lfp, "\n");
+    _untab();
+    NLFP (_lfp, "}\n");
+    return;
+  }
+
   NLFP (_lfp, "%s_template (%s_%dx%d) {\n", name,  prefix,
 	_trans_cnt, _load_cnt);
   _tab();
@@ -330,7 +585,7 @@ void Liberty::_dump_index_table (int idx, int sz, double *tab)
     if (i != 0) {
       fprintf (_lfp, ", ");
     }
-    fprintf (_lfp, "%g", tab[i]);
+    _val (tab[i]);
   }
   fprintf (_lfp, "\");");
 }
@@ -24,6 +24,10 @@
 
 #include <act/act.h>
 #include <act/passes.h>
+#include "logic.h"
+#include "prof.h"
+#include "simlog.h"
+#include "chardb.h"
 
 extern int verbose;
 
@@ -32,21 +36,30 @@ class Liberty {
   Liberty (const char *file);
   ~Liberty();
 
-  void dump_index_tables() {
-    _dump_index_table (1, _trans_cnt, _trans);
-    fprintf (_lfp, "\n");
-    _dump_index_table (2, _load_cnt, _load);
-    fprintf (_lfp, "\n");
-  }
+  void dump_index_tables();
+
+  /*-- a cell's text is built in memory and written in one go --*/
+  void cell_begin();
+  void cell_end();
 
  private:
-  FILE *_lfp;			/* file */
+  FILE *_lfp;			/* file, or the cell buffer */
+  FILE *_out;			/* the file, while a cell is buffered */
+  int _pipe;			/* 1 if _lfp is a pipe to a compressor */
+  char *_cbuf;
+  size_t _clen;
 
   void _tab();
   void _untab();
   void _line();
   int _tabs;
 
+  /*-- table values: xcell.lib_digits significant digits (as %g), or
+    the shortest string that reads back as the same double if 0 --*/
+  int _digits;
+  void _val (double v);
+  char *_index_lines;		/* both index tables, as printed */
+
   /*-- delay and power tables --*/
   int _trans_cnt;
   double *_trans;
@@ -65,6 +78,14 @@ class Liberty {
 };
 
 
+/*-- CCS output current waveform --*/
+struct ccs_wave {
+  int n;			// number of points
+  double ref;			// reference time (input at 50%)
+  double *t;			// time from the start of the window
+  double *i;			// current into the load
+};
+
 struct dynamic_case {
   int nidx;			// number of indices in idx used
   int idx[4];
@@ -73,35 +94,123 @@ struct dynamic_case {
   int in_init;			// 0/1 for rise/fall
   int out_init;			// 0/1 for rise/fall
 
+  int scen;			// scenario (time slot) used for measurement
+
   double *delay;		// delay table
   double *transit;		// transit time (slew) table
   double *intpow;		// internal power table
+
+  double *mc;			// Monte Carlo sums per table entry:
+				// samples, delay, delay^2, transit,
+				// transit^2 (NULL if not used)
+
+  struct ccs_wave *ccs;		// CCS waveforms per table entry
+				// (NULL if not used)
+};
+
+/*
+  A dynamic scenario is an input sequence that is simulated in a
+  single time slot. All dynamic cases that share the same input
+  sequence are measured from the same scenario.
+*/
+struct dynamic_scenario {
+  int nidx;			// number of indices in idx used
+  int idx[4];
+  int in_id;			// input id (related pin, switching)
+  int in_init;			// 0/1 for rise/fall
+  int narcs;			// number of dynamic cases measured here
+  int skip;			// # of leading idx[] steps that are not
+				// simulated, because the previous
+				// scenario already ends in idx[0]
+  int user;			// 1 if given in scenario.dynamic; its
+				// idx[0] step is always simulated
+};
+
+/*-- sequential arcs --*/
+#define SEQ_SETUP 0
+#define SEQ_HOLD  1
+#define SEQ_CLK2Q 2
+
+struct seq_arc {
+  int type;			// SEQ_SETUP, SEQ_HOLD, SEQ_CLK2Q
+  int pin;			// constrained input / output
+  int dir;			// 0/1 for rise/fall of data or output
+  double *val;			// constraint [clock slew][data slew]
+				// or delay [slew + load*nslew]
+  double *transit;		// SEQ_CLK2Q: output transition
 };
 
+struct seq_slot;
+
 class Cell {
  public:
   Cell (Liberty *l, Process *p);
+  Cell (Liberty *l, struct chardb *db, const struct chardb_cell *rec);
   ~Cell();
 
   void prepare() {
+    prof_begin (_p->getName(), "leakage");
     _run_leakage ();
+    prof_end ();
+    if (failed()) return;
+    prof_begin (_p->getName(), "input_cap");
     _run_input_cap ();
+    prof_end ();
+    if (failed()) return;
+    prof_begin (_p->getName(), "arcs");
     _calc_dynamic ();
+    prof_end ();
   }
   
   void characterize() {
     prepare ();
-    _run_dynamic ();
+    if (failed()) {
+      /* skip the timing runs */
+    }
+    else if (_is_external && _ext_type) {
+      prof_begin (_p->getName(), "sequential");
+      _run_sequential ();
+      prof_end ();
+    }
+    else {
+      prof_begin (_p->getName(), "dynamic");
+      _run_dynamic ();
+      prof_end ();
+    }
+    simlog_report (_p->getName());
   }
 
+  /*-- a deck that could not be written, run, or read fails the cell
+    rather than the library: the first problem and the simulator log
+    of its deck (NULL if there is none) --*/
+  int failed() { return _fail_msg != NULL; }
+  const char *fail_msg() { return _fail_msg; }
+  const char *fail_log() { return _fail_log; }
+
+  /*-- a dont_use cell with only the pins, for a failed cell --*/
+  void emit_placeholder();
+
   void emit() {
+    prof_begin (_cell_name(), "emit");
+    _l->cell_begin ();
+    _lfp = _l->_lfp;
     _printHeader ();
+    _emit_seq_state ();
     _emit_leakage ();
     _emit_input_cap ();
+    prof_begin (NULL, "dynamic");
     _emit_dynamic ();
+    prof_end ();
     _printFooter ();
+    _l->cell_end ();
+    _lfp = _l->_lfp;
+    prof_end ();
   }
 
+  void microbench();
+
+  void save (struct chardb_writer *w);
+
  private:
   Act *a;
   Process *_p;
@@ -110,6 +219,30 @@ class Cell {
   netlist_t *nl;
   ActNetlistPass *np;
 
+  void _init (Liberty *l);
+
+  char *_fail_msg;
+  char *_fail_log;
+  int _fail (const char *deck, const char *fmt, ...);
+
+  /*-- optional pass (repair, validate, Monte Carlo) being run, or
+    NULL; a failure inside one only abandons that pass --*/
+  const char *_optional;
+  int _opt_failed;
+
+  /*-- cell loaded from a characterization database: there is no
+    process or netlist, only what is needed to emit it --*/
+  char *_db_name;		// name as printed
+  char *_db_cfg;		// config prefix, xcell.cells.<cell>
+  char **_pin_names;		// inputs, then outputs
+
+  char **_lib_pins;		// mangled pin names for the .lib,
+				// inputs then outputs; see _lib_pin
+  const char *_lib_pin (int pos);
+
+  const char *_cell_name() { return _p ? _p->getName() : _db_name; }
+  int _has_data() { return nl || _db_name; }
+
   void _printHeader ();
   void _printFooter ();
 
@@ -128,6 +261,11 @@ class Cell {
     **/
     bitset_t *tt[2];
 
+    /**
+       compiled pull-down/pull-up guards over sh_vars[]
+    **/
+    struct logic_prog *prog[2];
+
     /**
        used for dynamic cases
     **/
@@ -147,32 +285,49 @@ class Cell {
   A_DECL (act_booleanized_var_t *, _sh_vars);
 
   bitset_t **_outvals; 	// value of outputs, followed by + sh_vars in order
+  int _num_outvals;
 
   int _num_outputs;	/* number of outputs */
   int _num_inputs;
 
   double *leakage_power;	/* leakage power */
+  bitset_t *_leak_sampled;	/* sparse cells: vectors whose leakage
+				   was simulated */
 
   void _add_support_var (ActId *id);
   void _collect_support (act_prs_expr_t *e);
-  int _eval_expr (act_prs_expr_t *e, unsigned int v);
-  void _build_truth_table (act_prs_expr_t *e, bitset_t *b);
+  void _calc_sh_inputs ();
+  int _logic_eval_expr (act_prs_expr_t *e, struct pHashtable *H, int *val);
+  void _logic_outvals ();
+  void _free_outvals ();
 
 
 
-  int _gen_spice_header (FILE *fp);
+  /*-- with probe set, every load is behind a 0V source Vlc<pin>,
+    and its current is mirrored to node cc<pin> for CCS --*/
+  int _gen_spice_header (FILE *fp, int probe = 0);
+  int _print_initial_state (FILE *fp, unsigned int v);
   int _get_input_pin (int pin);
   int _get_output_pin (int pin);
 
   void _sprint_input_pin (char *buf, int sz, int pin);
   void _sprint_output_pin (char *buf, int sz, int pin);
   
-  void _print_all_input_cases (FILE *fp, const char *prefix);
-  void _print_input_cap_cases (FILE *sfp, const char *prefix);
+  void _print_all_input_cases (FILE *fp, const char *prefix,
+			       int nvec, unsigned int *vec, double *slot);
+  void _print_input_cap_cases (FILE *sfp, const char *prefix,
+			       int nq, unsigned int *qv, double *slot);
   void _print_input_case (int idx, int skipmask = 0);
   void _print_input_case (FILE *fp, int idx, int skipmask = 0);
+  /*-- the set b as a sum of products: minimized if xcell.lib_minimize
+    is set, otherwise one term per vector; returns the number of
+    terms --*/
+  int _print_sop (bitset_t *b);
 
   int _run_leakage ();
+  int _leakage_vectors (unsigned int **vec);
+  int _read_leakage_trace (const char *file, char **outname, int nout,
+			   int nvec, unsigned int *vec, double *sample);
   int _run_dflow_leakage ();
   void _emit_leakage ();
 
@@ -181,6 +336,28 @@ class Cell {
   void _emit_input_cap ();
 
   int _run_dynamic ();
+  int _sim_dynamic (const char *tag, const char *preset, int nsel, int *sel);
+  int _write_dynamic (const char *file, const char *preset,
+		      int nsel, int *sel, int nmc, int mcbase,
+		      int ccs_load = -1);
+  int _read_dynamic (const char *file, int nsel, int *sel, int nmc);
+  double _sim_limit;		// watchdog limit of the last deck from
+				// _write_dynamic
+  int _sim_dynamic_timeout (const char *tag, const char *preset,
+			    int nsel, int *sel, const char *file);
+  void _run_mc ();
+  void _emit_mc_sigma (int idx, int which);
+  void _run_ccs ();
+  void _read_ccs (const char *file, int nload);
+  void _emit_ccs (int idx);
+  double *_ccs_off;		// CCS: window start of arc j, slew ns
+				// at [j*nslew + ns]
+  double *_arc_tab;		// delay/transit/intpow tables of all
+				// arcs, see _alloc_arc_tables
+  double *_alloc_arc_tables (int npts);
+  void _bind_arc_tables (double *tab, int npts);
+  void _validate_dynamic ();
+  void _repair_dynamic ();
   int _run_dflow_dynamic ();
   void _calc_dynamic ();
   void _emit_dynamic ();
@@ -191,8 +368,30 @@ class Cell {
 
   /* -- dynamic cases -- */
   A_DECL (struct dynamic_case, dyn);
+  int _user_dyn;		// dyn[0.._user_dyn-1] are from the
+				// scenario.dynamic table
   void _dump_dynamic (int idx);
 
+  /* -- scenarios shared by the dynamic cases -- */
+  A_DECL (struct dynamic_scenario, dscen);
+  void _calc_scenarios ();
+  void _schedule_scenarios ();
+
+  /* -- sequential cells -- */
+  A_DECL (struct seq_arc, seq);
+  int _clock_pin;		// clock input
+  int *_seq_inv;		// output is IQN rather than IQ
+  int _run_sequential ();
+  int _seq_constraints ();
+  int _seq_clk2q ();
+  void _seq_print_slots (FILE *sfp, int n, double *slot_t,
+			 struct seq_slot *sl, double *clk_slew,
+			 double *data_slew, int din, int *old);
+  void _emit_seq_state ();
+  void _emit_seq_constraints (int pin);
+  void _emit_seq_clk2q (int nout);
+  void _emit_table_values (double *val, int nrow, int ncol, double scale);
+
   char **fn_override;
 
   unsigned int _is_external:1;	// if it is external, then we should
@@ -201,6 +400,9 @@ class Cell {
   unsigned int _ext_type:3;	// 0 = combinational
                                 // 1 = ffpos, 2 = ffneg
                                 // 3 = latchhi, 4 = latchlo
+
+  unsigned int _sparse:1;	// high fan-in cell: only simulate a
+				// subset of the input vectors
 };
 
   
@@ -0,0 +1,466 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2021 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <common/misc.h>
+#include "logic.h"
+
+/*-- append an operation; track the stack depth as we go --*/
+static void _emit_op (struct logic_prog *p, int type, int var, int *sp)
+{
+  A_NEW (p->op, struct logic_op);
+  A_NEXT (p->op).type = type;
+  A_NEXT (p->op).var = var;
+  A_INC (p->op);
+
+  switch (type) {
+  case LOGIC_OP_VAR:
+  case LOGIC_OP_TRUE:
+  case LOGIC_OP_FALSE:
+    (*sp)++;
+    if (*sp > p->depth) {
+      p->depth = *sp;
+    }
+    break;
+
+  case LOGIC_OP_AND:
+  case LOGIC_OP_OR:
+    (*sp)--;
+    break;
+
+  default:
+    break;
+  }
+}
+
+static void _compile (struct logic_prog *p, act_prs_expr_t *e, Scope *s,
+		      struct pHashtable *H, int *sp)
+{
+  phash_bucket_t *b;
+
+  if (!e) {
+    _emit_op (p, LOGIC_OP_FALSE, 0, sp);
+    return;
+  }
+  switch (e->type) {
+  case ACT_PRS_EXPR_AND:
+    _compile (p, e->u.e.l, s, H, sp);
+    _compile (p, e->u.e.r, s, H, sp);
+    _emit_op (p, LOGIC_OP_AND, 0, sp);
+    break;
+
+  case ACT_PRS_EXPR_OR:
+    _compile (p, e->u.e.l, s, H, sp);
+    _compile (p, e->u.e.r, s, H, sp);
+    _emit_op (p, LOGIC_OP_OR, 0, sp);
+    break;
+
+  case ACT_PRS_EXPR_NOT:
+    _compile (p, e->u.e.l, s, H, sp);
+    _emit_op (p, LOGIC_OP_NOT, 0, sp);
+    break;
+
+  case ACT_PRS_EXPR_LABEL:
+    warning ("labels within state-holding gate...");
+    _emit_op (p, LOGIC_OP_FALSE, 0, sp);
+    break;
+
+  case ACT_PRS_EXPR_TRUE:
+    _emit_op (p, LOGIC_OP_TRUE, 0, sp);
+    break;
+
+  case ACT_PRS_EXPR_FALSE:
+    _emit_op (p, LOGIC_OP_FALSE, 0, sp);
+    break;
+
+  case ACT_PRS_EXPR_VAR:
+    b = phash_lookup (H, e->u.v.id->Canonical (s));
+    if (!b) {
+      fatal_error ("Didn't find input variable?!");
+    }
+    _emit_op (p, LOGIC_OP_VAR, b->i, sp);
+    break;
+
+  default:
+    fatal_error ("Unexpected type %d", e->type);
+    break;
+  }
+}
+
+struct logic_prog *logic_compile (act_prs_expr_t *e, Scope *s,
+				  struct pHashtable *H)
+{
+  struct logic_prog *p;
+  int sp = 0;
+
+  NEW (p, struct logic_prog);
+  A_INIT (p->op);
+  p->depth = 0;
+  _compile (p, e, s, H, &sp);
+  Assert (sp == 1, "Unbalanced logic program");
+  return p;
+}
+
+void logic_free (struct logic_prog *p)
+{
+  A_FREE (p->op);
+  FREE (p);
+}
+
+logic_word_t logic_eval (struct logic_prog *p, logic_word_t *var,
+			 logic_word_t *stack)
+{
+  int sp = 0;
+
+  for (int i=0; i < A_LEN (p->op); i++) {
+    switch (p->op[i].type) {
+    case LOGIC_OP_VAR:
+      stack[sp++] = var[p->op[i].var];
+      break;
+    case LOGIC_OP_TRUE:
+      stack[sp++] = ~(logic_word_t)0;
+      break;
+    case LOGIC_OP_FALSE:
+      stack[sp++] = 0;
+      break;
+    case LOGIC_OP_AND:
+      sp--;
+      stack[sp-1] &= stack[sp];
+      break;
+    case LOGIC_OP_OR:
+      sp--;
+      stack[sp-1] |= stack[sp];
+      break;
+    case LOGIC_OP_NOT:
+      stack[sp-1] = ~stack[sp-1];
+      break;
+    }
+  }
+  return stack[0];
+}
+
+logic_word_t logic_enum_word (int i, unsigned int base)
+{
+  /* -- bit i of the vector index, for the 64 vectors in this word -- */
+  static const logic_word_t pat[6] = {
+    0xaaaaaaaaaaaaaaaaULL,
+    0xccccccccccccccccULL,
+    0xf0f0f0f0f0f0f0f0ULL,
+    0xff00ff00ff00ff00ULL,
+    0xffff0000ffff0000ULL,
+    0xffffffff00000000ULL
+  };
+  if (i < 6) {
+    return pat[i];
+  }
+  return ((base >> i) & 1) ? ~(logic_word_t)0 : 0;
+}
+
+logic_word_t logic_mask (unsigned int base, unsigned int nvec)
+{
+  if (nvec - base >= LOGIC_WORD_BITS) {
+    return ~(logic_word_t)0;
+  }
+  return (((logic_word_t)1) << (nvec - base)) - 1;
+}
+
+/*
+  The bitset keeps bit v in bit v % W of word b[v / W], with W the
+  width of its words; base is a multiple of LOGIC_WORD_BITS, so a
+  logic word is made of whole bitset words.
+*/
+#define BITSET_WBITS(b) (8*sizeof ((b)->b[0]))
+
+logic_word_t logic_get_word (bitset_t *b, unsigned int base,
+			     unsigned int nvec)
+{
+  logic_word_t w = 0;
+  unsigned int wb = BITSET_WBITS (b);
+
+  for (unsigned int k=0; k < LOGIC_WORD_BITS && base + k < nvec; k += wb) {
+    w |= ((logic_word_t) b->b[(base + k)/wb]) << k;
+  }
+  return w & logic_mask (base, nvec);
+}
+
+void logic_set_word (bitset_t *b, unsigned int base, logic_word_t w)
+{
+  unsigned int wb = BITSET_WBITS (b);
+
+  for (unsigned int k=0; k < LOGIC_WORD_BITS && (w >> k); k += wb) {
+    b->b[(base + k)/wb] |= (w >> k);
+  }
+}
+
+void logic_truth_table (struct logic_prog *p, int nvars, bitset_t *b)
+{
+  logic_word_t *var, *stack;
+  unsigned int nvec = (1U << nvars);
+
+  MALLOC (var, logic_word_t, nvars > 0 ? nvars : 1);
+  MALLOC (stack, logic_word_t, p->depth);
+
+  bitset_clear (b);
+  for (unsigned int base=0; base < nvec; base += LOGIC_WORD_BITS) {
+    for (int i=0; i < nvars; i++) {
+      var[i] = logic_enum_word (i, base);
+    }
+    logic_set_word (b, base,
+		    logic_eval (p, var, stack) & logic_mask (base, nvec));
+  }
+  FREE (var);
+  FREE (stack);
+}
+
+
+/*------------------------------------------------------------------------
+ *
+ *  Two-level minimization
+ *
+ *------------------------------------------------------------------------
+ */
+static int _cube_cmp (const void *a, const void *b)
+{
+  const struct logic_cube *x = (const struct logic_cube *)a;
+  const struct logic_cube *y = (const struct logic_cube *)b;
+
+  if (x->care != y->care) {
+    return x->care < y->care ? -1 : 1;
+  }
+  if (x->val != y->val) {
+    return x->val < y->val ? -1 : 1;
+  }
+  return 0;
+}
+
+/*-- sort and drop duplicates; returns the new length --*/
+static int _cube_uniq (struct logic_cube *c, int n)
+{
+  int k;
+  
+  if (n == 0) return 0;
+  qsort (c, n, sizeof (struct logic_cube), _cube_cmp);
+  k = 1;
+  for (int i=1; i < n; i++) {
+    if (_cube_cmp (&c[i], &c[k-1]) != 0) {
+      c[k++] = c[i];
+    }
+  }
+  return k;
+}
+
+static int _cube_lits (const struct logic_cube *c)
+{
+  return __builtin_popcount (c->care);
+}
+
+struct logic_cube *logic_sop (int nvars, bitset_t *on, bitset_t *dc,
+			      int *ncubes)
+{
+  unsigned int nvec = (1U << nvars);
+  unsigned int all = nvec - 1;
+  A_DECL (struct logic_cube, cur);
+  A_DECL (struct logic_cube, nxt);
+  A_DECL (struct logic_cube, prime);
+  A_DECL (unsigned int, mt);
+  struct logic_cube *res;
+  int nres;
+  
+  A_INIT (cur);
+  A_INIT (nxt);
+  A_INIT (prime);
+  A_INIT (mt);
+
+  for (unsigned int i=0; i < nvec; i++) {
+    int is_on = bitset_tst (on, i);
+    if (is_on) {
+      A_NEW (mt, unsigned int);
+      A_NEXT (mt) = i;
+      A_INC (mt);
+    }
+    if (is_on || (dc && bitset_tst (dc, i))) {
+      A_NEW (cur, struct logic_cube);
+      A_NEXT (cur).val = i;
+      A_NEXT (cur).care = all;
+      A_INC (cur);
+    }
+  }
+
+  *ncubes = 0;
+  if (A_LEN (mt) == 0) {
+    A_FREE (cur);
+    A_FREE (mt);
+    return NULL;
+  }
+
+  if (nvars > LOGIC_SOP_MAX_VARS) {
+    /*-- too big: the minterms themselves --*/
+    MALLOC (res, struct logic_cube, A_LEN (mt));
+    for (int i=0; i < A_LEN (mt); i++) {
+      res[i].val = mt[i];
+      res[i].care = all;
+    }
+    *ncubes = A_LEN (mt);
+    A_FREE (cur);
+    A_FREE (mt);
+    return res;
+  }
+
+  /*-- prime implicants: merge cubes that differ in one care variable;
+    cubes that never merge are prime --*/
+  while (A_LEN (cur) > 0) {
+    char *used;
+    
+    MALLOC (used, char, A_LEN (cur));
+    for (int i=0; i < A_LEN (cur); i++) {
+      used[i] = 0;
+    }
+    /* cur is sorted by (care, val), so partners are found by bsearch */
+    for (int i=0; i < A_LEN (cur); i++) {
+      unsigned int free_bits = cur[i].care & ~cur[i].val;
+      while (free_bits) {
+	unsigned int b = free_bits & -free_bits;
+	struct logic_cube key, *m;
+	free_bits &= ~b;
+	key.care = cur[i].care;
+	key.val = cur[i].val | b;
+	m = (struct logic_cube *)
+	  bsearch (&key, cur + i + 1, A_LEN (cur) - i - 1,
+		   sizeof (struct logic_cube), _cube_cmp);
+	if (m) {
+	  used[i] = 1;
+	  used[m - cur] = 1;
+	  A_NEW (nxt, struct logic_cube);
+	  A_NEXT (nxt).val = cur[i].val;
+	  A_NEXT (nxt).care = cur[i].care & ~b;
+	  A_INC (nxt);
+	}
+      }
+      if (!used[i]) {
+	A_NEW (prime, struct logic_cube);
+	A_NEXT (prime) = cur[i];
+	A_INC (prime);
+      }
+    }
+    FREE (used);
+    
+    /*-- the merged cubes, without duplicates, are the next round --*/
+    A_FREE (cur);
+    A_INIT (cur);
+    int nuniq = _cube_uniq (nxt, A_LEN (nxt));
+    for (int i=0; i < nuniq; i++) {
+      A_NEW (cur, struct logic_cube);
+      A_NEXT (cur) = nxt[i];
+      A_INC (cur);
+    }
+    A_FREE (nxt);
+    A_INIT (nxt);
+  }
+  A_FREE (cur);
+
+  /*-- cover the on-set --*/
+  char *covered, *chosen;
+  int left = A_LEN (mt);
+  
+  MALLOC (covered, char, A_LEN (mt));
+  MALLOC (chosen, char, A_LEN (prime));
+  for (int j=0; j < A_LEN (mt); j++) {
+    covered[j] = 0;
+  }
+  for (int i=0; i < A_LEN (prime); i++) {
+    chosen[i] = 0;
+  }
+
+#define COVERS(p,m) (((m) & (p).care) == (p).val)
+
+  /* essential primes: the only cover of some minterm */
+  for (int j=0; j < A_LEN (mt); j++) {
+    int who = -1, cnt = 0;
+    for (int i=0; i < A_LEN (prime) && cnt < 2; i++) {
+      if (COVERS (prime[i], mt[j])) {
+	who = i;
+	cnt++;
+      }
+    }
+    Assert (cnt > 0, "Minterm without a prime implicant?");
+    if (cnt == 1) {
+      chosen[who] = 1;
+    }
+  }
+  for (int i=0; i < A_LEN (prime); i++) {
+    if (!chosen[i]) continue;
+    for (int j=0; j < A_LEN (mt); j++) {
+      if (!covered[j] && COVERS (prime[i], mt[j])) {
+	covered[j] = 1;
+	left--;
+      }
+    }
+  }
+
+  /* the rest, greedily; fewer literals break ties */
+  while (left > 0) {
+    int best = -1, bestcnt = 0;
+    for (int i=0; i < A_LEN (prime); i++) {
+      int cnt = 0;
+      if (chosen[i]) continue;
+      for (int j=0; j < A_LEN (mt); j++) {
+	if (!covered[j] && COVERS (prime[i], mt[j])) {
+	  cnt++;
+	}
+      }
+      if (cnt > bestcnt ||
+	  (cnt == bestcnt && cnt > 0 &&
+	   _cube_lits (&prime[i]) < _cube_lits (&prime[best]))) {
+	best = i;
+	bestcnt = cnt;
+      }
+    }
+    Assert (best >= 0, "Uncoverable minterm?");
+    chosen[best] = 1;
+    for (int j=0; j < A_LEN (mt); j++) {
+      if (!covered[j] && COVERS (prime[best], mt[j])) {
+	covered[j] = 1;
+	left--;
+      }
+    }
+  }
+#undef COVERS
+
+  nres = 0;
+  for (int i=0; i < A_LEN (prime); i++) {
+    if (chosen[i]) nres++;
+  }
+  MALLOC (res, struct logic_cube, nres);
+  nres = 0;
+  for (int i=0; i < A_LEN (prime); i++) {
+    if (chosen[i]) {
+      res[nres++] = prime[i];
+    }
+  }
+  FREE (covered);
+  FREE (chosen);
+  A_FREE (prime);
+  A_FREE (mt);
+
+  *ncubes = nres;
+  return res;
+}
@@ -0,0 +1,120 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2021 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#ifndef __XCELL_LOGIC_H__
+#define __XCELL_LOGIC_H__
+
+#include <act/act.h>
+#include <common/array.h>
+#include <common/hash.h>
+#include <common/bitset.h>
+
+/*
+  Word-level evaluation of production rule guards.
+
+  A guard is compiled once into a postfix program whose variables are
+  already resolved to small integer indices. Evaluation works on whole
+  machine words: bit k of the word for variable i is the value of that
+  variable in the k-th vector, so one pass over the program evaluates
+  LOGIC_WORD_BITS vectors at once.
+*/
+typedef unsigned long long logic_word_t;
+
+#define LOGIC_WORD_BITS 64
+
+enum logic_opcode {
+  LOGIC_OP_VAR,
+  LOGIC_OP_TRUE,
+  LOGIC_OP_FALSE,
+  LOGIC_OP_AND,
+  LOGIC_OP_OR,
+  LOGIC_OP_NOT
+};
+
+struct logic_op {
+  int type;			/* enum logic_opcode */
+  int var;			/* variable index for LOGIC_OP_VAR */
+};
+
+struct logic_prog {
+  A_DECL (struct logic_op, op);
+  int depth;			/* stack depth needed to evaluate */
+};
+
+/*
+  Compile expression e. H maps canonical connections (within scope s)
+  to variable indices in b->i; every variable in e must be in H.
+*/
+struct logic_prog *logic_compile (act_prs_expr_t *e, Scope *s,
+				  struct pHashtable *H);
+void logic_free (struct logic_prog *p);
+
+/*
+  Evaluate p; var[i] is the word for variable i, and stack must have
+  room for p->depth words.
+*/
+logic_word_t logic_eval (struct logic_prog *p, logic_word_t *var,
+			 logic_word_t *stack);
+
+/*
+  Word for variable i when enumerating all vectors: vector v has
+  variable i set to bit i of v, and base is the first vector in the
+  word (a multiple of LOGIC_WORD_BITS).
+*/
+logic_word_t logic_enum_word (int i, unsigned int base);
+
+/* mask for the valid bits of the word starting at base, out of nvec */
+logic_word_t logic_mask (unsigned int base, unsigned int nvec);
+
+/* truth table of p over all 2^nvars assignments to its variables */
+void logic_truth_table (struct logic_prog *p, int nvars, bitset_t *b);
+
+/* move a word of bits between a bitset and a logic word */
+logic_word_t logic_get_word (bitset_t *b, unsigned int base,
+			     unsigned int nvec);
+void logic_set_word (bitset_t *b, unsigned int base, logic_word_t w);
+
+
+/*
+  Two-level minimization. A cube is a product term: variable i
+  appears in it iff bit i of care is set, complemented iff bit i of
+  val is clear (val has no bits outside care). A cube with care == 0
+  is the constant 1.
+*/
+struct logic_cube {
+  unsigned int val;
+  unsigned int care;
+};
+
+/* functions of more variables are returned as minterms */
+#define LOGIC_SOP_MAX_VARS 12
+
+/*
+  Sum-of-products cover of the on-set over nvars variables, using the
+  optional don't-care set dc: all prime implicants (Quine-McCluskey),
+  then the essential primes, then greedily the prime covering the most
+  remaining minterms. Returns a MALLOC'd array of *ncubes cubes (NULL
+  if the on-set is empty).
+*/
+struct logic_cube *logic_sop (int nvars, bitset_t *on, bitset_t *dc,
+			      int *ncubes);
+
+#endif /* __XCELL_LOGIC_H__ */
@@ -20,10 +20,80 @@
  **************************************************************************
  */
 #include <stdio.h>
+#include <string.h>
 #include "liberty.h"
+#include "progress.h"
+#include "microbench.h"
+#include "watchdog.h"
 
 int verbose;
 
+/*
+  A .xdb argument is a characterization database; the library is
+  regenerated from it without parsing ACT or simulating.
+*/
+static int is_db (const char *file)
+{
+  int len = strlen (file);
+  return len > 4 && strcmp (file + len - 4, ".xdb") == 0;
+}
+
+static void check_db_table (struct chardb *db, const char *name,
+			    int n, uint64_t off)
+{
+  const double *v;
+
+  v = (const double *) chardb_ptr (db, off, sizeof (double)*n);
+  if (config_get_table_size (name) != n || !v ||
+      memcmp (v, config_get_table_real (name), sizeof (double)*n) != 0) {
+    fatal_error ("%s: characterized with a different %s table",
+		 db->file, name);
+  }
+}
+
+/*-- unit conversions, in chardb header order (see CHARDB_NUNITS) --*/
+static const char *db_units[CHARDB_NUNITS] = {
+  "xcell.units.time_conv", "xcell.units.cap_conv",
+  "xcell.units.current_conv", "xcell.units.power_conv",
+  "xcell.units.resis_conv"
+};
+
+static void check_db_real (struct chardb *db, const char *name, double v)
+{
+  if (config_get_real (name) != v) {
+    fatal_error ("%s: characterized with a different %s (%g, now %g)",
+		 db->file, name, v, config_get_real (name));
+  }
+}
+
+static int lib_from_db (const char *file, const char *lib)
+{
+  struct chardb *db = chardb_open (file);
+
+  if (!db) {
+    fatal_error ("Could not read database `%s'", file);
+  }
+  check_db_table (db, "xcell.input_trans", db->hdr->ntrans, db->hdr->trans);
+  check_db_table (db, "xcell.load", db->hdr->nload, db->hdr->load);
+  check_db_real (db, "xcell.Vdd", db->hdr->vdd);
+  check_db_real (db, "xcell.short_window", db->hdr->window);
+
+  /*-- the unit conversions are only normalized by the Liberty
+    constructor --*/
+  Liberty L(lib);
+  for (int i=0; i < CHARDB_NUNITS; i++) {
+    check_db_real (db, db_units[i], db->hdr->units[i]);
+  }
+  for (unsigned int i=0; i < db->hdr->ncells; i++) {
+    Cell *c = new Cell (&L, db, &db->cells[i]);
+    c->emit();
+    delete c;
+  }
+  chardb_free (db);
+  prof_finish ();
+  return 0;
+}
+
 int main (int argc, char **argv)
 {
   Act *a;
@@ -39,20 +109,113 @@ int main (int argc, char **argv)
   list_free (l);
 
   if (argc != 3) {
-    fatal_error ("Usage: %s <act-cell-file> <libname>\n", argv[0]);
+    fatal_error ("Usage: %s <act-cell-file>|<db.xdb> <libname>\n", argv[0]);
+  }
+  if (is_db (argv[1])) {
+    a = new Act (NULL);
+  }
+  else {
+    a = new Act (argv[1]);
+    a->Expand ();
   }
-  a = new Act (argv[1]);
-  a->Expand ();
 
   config_set_default_int ("xcell.verbose", 0);
   config_set_default_int ("net.emit_parasitics", 1);
+  config_set_default_real ("xcell.settle_margin", 1000);
+  config_set_default_int ("xcell.chain_scenarios", 1);
+  config_set_default_real ("xcell.leak_settle", 1000);
+  config_set_default_int ("xcell.max_inputs", 16);
+  config_set_default_int ("xcell.sparse.min_inputs", 8);
+  config_set_default_int ("xcell.sparse.leak_samples", 16);
+  config_set_default_int ("xcell.sparse.cap_samples", 2);
+  config_set_default_int ("xcell.logic_from_prs", 0);
+  config_set_default_int ("xcell.logic_check", 4);
+  config_set_default_int ("xcell.initial_state", 2);
+  config_set_default_real ("xcell.ic_hold", 100);
+
+  config_set_default_string ("xcell.accuracy", "standard");
+  config_set_default_real ("xcell.preset.draft.tstep", 1);
+  config_set_default_real ("xcell.preset.draft.tmax", 20);
+  config_set_default_real ("xcell.preset.draft.reltol", 1e-2);
+  config_set_default_string ("xcell.preset.draft.method", "trap");
+  config_set_default_real ("xcell.preset.standard.tstep", 0.1);
+  config_set_default_real ("xcell.preset.signoff.tstep", 0.05);
+  config_set_default_real ("xcell.preset.signoff.tmax", 1);
+  config_set_default_real ("xcell.preset.signoff.reltol", 1e-4);
+  config_set_default_string ("xcell.preset.signoff.method", "gear");
+  config_set_default_int ("xcell.validate", 0);
+  config_set_default_string ("xcell.validate_preset", "signoff");
+  config_set_default_real ("xcell.validate_tol", 2);
+  config_set_default_int ("xcell.jobs", 0);
+  config_set_default_int ("xcell.mc.samples", 0);
+  config_set_default_string ("xcell.mc.param", "mc_sample");
+  config_set_default_int ("xcell.mc.batch", 16);
+  config_set_default_int ("xcell.mc.min_samples", 32);
+  config_set_default_real ("xcell.mc.tol", 2);
+  config_set_default_int ("xcell.repair.enable", 1);
+  config_set_default_string ("xcell.repair.preset", "signoff");
+  config_set_default_real ("xcell.repair.window", 2);
+  config_set_default_real ("xcell.repair.tol", 5);
+  config_set_default_int ("xcell.watchdog.enable", 1);
+  config_set_default_real ("xcell.watchdog.base", 120);
+  config_set_default_real ("xcell.watchdog.per_ns", 2);
+  config_set_default_real ("xcell.watchdog.per_measure", 0.1);
+  config_set_default_real ("xcell.watchdog.wall_factor", 4);
+  config_set_default_real ("xcell.preset.robust.tstep", 1);
+  config_set_default_real ("xcell.preset.robust.tmax", 10);
+  config_set_default_real ("xcell.preset.robust.reltol", 1e-3);
+  config_set_default_string ("xcell.preset.robust.method", "gear");
+  config_set_default_int ("xcell.fail.placeholder", 0);
+  config_set_default_string ("xcell.fail.retry_preset", "");
+  config_set_default_int ("xcell.ccs.enable", 0);
+  config_set_default_int ("xcell.ccs.points", 20);
+  config_set_default_real ("xcell.ccs.tol", 1);
+  config_set_default_real ("xcell.simlog.max_reject", 0.2);
+  config_set_default_real ("xcell.simlog.max_setup", 0.5);
+  config_set_default_real ("xcell.simlog.min_time", 1);
+  config_set_default_real ("xcell.status_interval", 10);
+  config_set_default_int ("xcell.seq.probes", 3);
+  config_set_default_int ("xcell.db", 1);
+  config_set_default_int ("xcell.lib_digits", 6);
+  config_set_default_string ("xcell.lib_compress", "");
+  config_set_default_int ("xcell.lib_minimize", 1);
+  config_set_default_real ("xcell.microbench.min_time", 0.05);
+  config_set_default_int ("xcell.microbench.reps", 5);
+  config_set_default_real ("xcell.microbench.tol", 20);
+  config_set_default_real ("xcell.seq.tol", 1);
 
   verbose = config_get_int ("xcell.verbose");
+  prof_init ();
+  if (is_db (argv[1])) {
+    return lib_from_db (argv[1], argv[2]);
+  }
+  int mb = mb_init ();
+
+  if (config_get_int ("xcell.max_inputs") > 24) {
+    warning ("xcell.max_inputs is limited to 24");
+    config_set_int ("xcell.max_inputs", 24);
+  }
 
   ActNetlistPass *np = new ActNetlistPass (a);
   np->run();
 
   Liberty L(argv[2]);
+
+  /*-- characterization database, <libname>.xdb --*/
+  struct chardb_writer *dbw = NULL;
+  if (!mb && config_get_int ("xcell.db")) {
+    double units[CHARDB_NUNITS];
+    for (int i=0; i < CHARDB_NUNITS; i++) {
+      units[i] = config_get_real (db_units[i]);
+    }
+    snprintf (buf, 1024, "%s.xdb", argv[2]);
+    dbw = chardb_create (buf, config_get_real ("xcell.Vdd"),
+			 config_get_real ("xcell.short_window"), units,
+			 config_get_table_size ("xcell.input_trans"),
+			 config_get_table_real ("xcell.input_trans"),
+			 config_get_table_size ("xcell.load"),
+			 config_get_table_real ("xcell.load"));
+  }
   
   UserDef  *topu = a->Global()->findType ("characterize<>");
   if (!topu) {
@@ -64,6 +227,34 @@ int main (int argc, char **argv)
     fatal_error ("File `%s': missing top-level characterize process", argv[1]);
   }
 
+  /*-- count the cells and estimate their cost for the ETA --*/
+  A_DECL (double, cost);
+  A_INIT (cost);
+  for (int i=1; i; i++) {
+    char buf[1024];
+    InstType *it;
+
+    snprintf (buf, 1024, "g%d", i);
+    it = top->Lookup (buf);
+    if (!it) {
+      break;
+    }
+    if (TypeFactory::isProcessType (it)) {
+      A_NEW (cost, double);
+      A_NEXT (cost) =
+	progress_cost (np->getNL (dynamic_cast<Process *>(it->BaseType())));
+      A_INC (cost);
+    }
+  }
+  progress_init (A_LEN (cost), cost);
+  A_FREE (cost);
+
+  /*-- cells that could not be characterized, as report lines --*/
+  A_DECL (char *, fails);
+  A_INIT (fails);
+  const char *retry = config_get_string ("xcell.fail.retry_preset");
+
+  int ncell = 0;
   for (int i=1; i; i++) {
     char buf[1024];
     netlist_t *nl;
@@ -80,11 +271,63 @@ int main (int argc, char **argv)
     if (TypeFactory::isProcessType (it)) {
       p = dynamic_cast<Process *>(it->BaseType());
 
+      progress_cell_begin (ncell++, p->getName());
       Cell *c = new Cell (&L, p);
-      c->characterize();
-      c->emit();
+      if (mb) {
+	c->microbench();
+      }
+      else {
+	c->characterize();
+	if (c->failed() && retry && *retry) {
+	  char *acc = Strdup (config_get_string ("xcell.accuracy"));
+	  printf ("  retrying %s with preset `%s'\n", p->getName(), retry);
+	  delete c;
+	  config_set_string ("xcell.accuracy", retry);
+	  c = new Cell (&L, p);
+	  c->characterize();
+	  config_set_string ("xcell.accuracy", acc);
+	  FREE (acc);
+	}
+	if (!c->failed()) {
+	  c->emit();
+	  if (dbw) {
+	    c->save (dbw);
+	  }
+	}
+	else {
+	  snprintf (buf, 1024, "%s: %s%s%s", p->getName(), c->fail_msg(),
+		    c->fail_log() ? "; see " : "",
+		    c->fail_log() ? c->fail_log() : "");
+	  A_NEW (fails, char *);
+	  A_NEXT (fails) = Strdup (buf);
+	  A_INC (fails);
+	  if (config_get_int ("xcell.fail.placeholder")) {
+	    c->emit_placeholder();
+	  }
+	}
+      }
       delete c;
+      progress_cell_end ();
+    }
+  }
+  if (dbw) {
+    chardb_close (dbw);
+  }
+  prof_finish ();
+  if (mb && mb_finish () > 0) {
+    return 1;
+  }
+  wd_report ();
+  if (A_LEN (fails) > 0) {
+    printf ("\n%d of %d cells failed%s:\n", A_LEN (fails), ncell,
+	    config_get_int ("xcell.fail.placeholder") ?
+	    " (emitted as dont_use)" : " (not in the library)");
+    for (int i=0; i < A_LEN (fails); i++) {
+      printf ("  %s\n", fails[i]);
+      FREE (fails[i]);
     }
+    A_FREE (fails);
+    return 1;
   }
   return 0;
 }  
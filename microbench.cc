@@ -0,0 +1,255 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2021 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <common/config.h>
+#include <common/misc.h>
+#include "microbench.h"
+
+struct mb_result {
+  char *cell;
+  char *kernel;
+  int ninputs;
+  long iters;			/* iterations per batch */
+  double ns;			/* median ns per iteration */
+  double base_ns;		/* baseline, -1 if none */
+};
+
+static int mb_on = 0;
+static A_DECL (struct mb_result, res);
+static A_DECL (struct mb_result, base);
+
+/*-- current kernel --*/
+static struct mb_result *cur = NULL;
+static int cur_fixed;		/* iteration count from the baseline */
+static long cur_count;
+static int cur_rep;
+static double cur_start;
+static double *cur_t;
+
+static double now ()
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static int _dbl_cmp (const void *a, const void *b)
+{
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+  return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static struct mb_result *find_base (const char *cell, const char *kernel)
+{
+  for (int i=0; i < A_LEN (base); i++) {
+    if (strcmp (base[i].cell, cell) == 0 &&
+	strcmp (base[i].kernel, kernel) == 0) {
+      return &base[i];
+    }
+  }
+  return NULL;
+}
+
+/*
+  Baseline file: one line per cell/kernel
+    cell kernel ninputs iters ns-per-iter
+*/
+int mb_init ()
+{
+  FILE *fp;
+  char buf[1024];
+
+  if (!config_exists ("xcell.microbench.baseline")) {
+    return 0;
+  }
+  mb_on = 1;
+  A_INIT (res);
+  A_INIT (base);
+
+  fp = fopen (config_get_string ("xcell.microbench.baseline"), "r");
+  if (!fp) {
+    return 1;
+  }
+  while (fgets (buf, 1024, fp)) {
+    char cell[1024], kernel[1024];
+    int n;
+    long iters;
+    double ns;
+
+    if (buf[0] == '#') continue;
+    if (sscanf (buf, "%s %s %d %ld %lf", cell, kernel, &n, &iters, &ns) != 5) {
+      continue;
+    }
+    A_NEW (base, struct mb_result);
+    A_NEXT (base).cell = Strdup (cell);
+    A_NEXT (base).kernel = Strdup (kernel);
+    A_NEXT (base).ninputs = n;
+    A_NEXT (base).iters = iters;
+    A_NEXT (base).ns = ns;
+    A_NEXT (base).base_ns = -1;
+    A_INC (base);
+  }
+  fclose (fp);
+  return 1;
+}
+
+void mb_begin (const char *cell, const char *kernel, int ninputs)
+{
+  struct mb_result *b;
+
+  if (!mb_on) return;
+
+  A_NEW (res, struct mb_result);
+  cur = &A_NEXT (res);
+  A_INC (res);
+
+  cur->cell = Strdup (cell);
+  cur->kernel = Strdup (kernel);
+  cur->ninputs = ninputs;
+  cur->ns = 0;
+
+  b = find_base (cell, kernel);
+  if (b) {
+    cur->iters = b->iters;
+    cur->base_ns = b->ns;
+    cur_fixed = 1;
+  }
+  else {
+    cur->iters = 1;
+    cur->base_ns = -1;
+    cur_fixed = 0;
+  }
+  cur_count = 0;
+  cur_rep = 0;
+  MALLOC (cur_t, double, config_get_int ("xcell.microbench.reps"));
+  cur_start = now ();
+}
+
+int mb_iter ()
+{
+  double t;
+  int reps;
+
+  if (!cur) {
+    return 0;
+  }
+  if (cur_count < cur->iters) {
+    cur_count++;
+    return 1;
+  }
+
+  /*-- end of a batch --*/
+  t = now () - cur_start;
+  reps = config_get_int ("xcell.microbench.reps");
+
+  if (!cur_fixed && t < config_get_real ("xcell.microbench.min_time")) {
+    /*-- still calibrating --*/
+    cur->iters *= 2;
+  }
+  else {
+    cur_fixed = 1;
+    cur_t[cur_rep++] = t;
+    if (cur_rep == reps) {
+      qsort (cur_t, reps, sizeof (double), _dbl_cmp);
+      cur->ns = cur_t[reps/2]*1e9/cur->iters;
+      FREE (cur_t);
+      cur = NULL;
+      return 0;
+    }
+  }
+  cur_count = 1;
+  cur_start = now ();
+  return 1;
+}
+
+int mb_finish ()
+{
+  FILE *fp;
+  int nbad = 0;
+  int nnew = 0;
+  double tol = config_get_real ("xcell.microbench.tol");
+
+  if (!mb_on) return 0;
+
+  printf ("%-24s %-20s %3s %10s %14s %14s %8s\n", "cell", "kernel", "in",
+	  "iters", "ns/iter", "baseline", "ratio");
+  for (int i=0; i < A_LEN (res); i++) {
+    struct mb_result *r = &res[i];
+    printf ("%-24s %-20s %3d %10ld %14.1f", r->cell, r->kernel,
+	    r->ninputs, r->iters, r->ns);
+    if (r->base_ns > 0) {
+      double ratio = r->ns/r->base_ns;
+      printf (" %14.1f %8.2f", r->base_ns, ratio);
+      if (ratio > 1 + tol/100.0) {
+	printf ("  REGRESSION");
+	nbad++;
+      }
+    }
+    else {
+      nnew++;
+    }
+    printf ("\n");
+  }
+
+  /*-- new entries are appended to the baseline --*/
+  if (nnew > 0) {
+    fp = fopen (config_get_string ("xcell.microbench.baseline"), "a");
+    if (!fp) {
+      warning ("Could not open baseline file `%s' for writing",
+	       config_get_string ("xcell.microbench.baseline"));
+    }
+    else {
+      if (A_LEN (base) == 0) {
+	fprintf (fp, "# cell kernel ninputs iters ns-per-iter\n");
+      }
+      for (int i=0; i < A_LEN (res); i++) {
+	if (res[i].base_ns > 0) continue;
+	fprintf (fp, "%s %s %d %ld %g\n", res[i].cell, res[i].kernel,
+		 res[i].ninputs, res[i].iters, res[i].ns);
+      }
+      fclose (fp);
+      printf ("%d new entries written to baseline `%s'\n", nnew,
+	      config_get_string ("xcell.microbench.baseline"));
+    }
+  }
+  if (nbad > 0) {
+    warning ("%d kernel(s) more than %g%% slower than the baseline", nbad,
+	     tol);
+  }
+
+  for (int i=0; i < A_LEN (res); i++) {
+    FREE (res[i].cell);
+    FREE (res[i].kernel);
+  }
+  A_FREE (res);
+  for (int i=0; i < A_LEN (base); i++) {
+    FREE (base[i].cell);
+    FREE (base[i].kernel);
+  }
+  A_FREE (base);
+  mb_on = 0;
+  return nbad;
+}
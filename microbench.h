@@ -0,0 +1,52 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2021 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#ifndef __XCELL_MICROBENCH_H__
+#define __XCELL_MICROBENCH_H__
+
+/*
+  Micro-benchmarks of the CPU-side kernels (scenario generation and
+  post-processing), enabled by setting xcell.microbench.baseline to a
+  file name. No simulations are run.
+
+    mb_init ()                 : start if xcell.microbench.baseline is set;
+                                 returns 0 otherwise
+    mb_begin (cell, kernel, n) : start timing kernel for a cell with
+                                 n inputs
+    mb_iter ()                 : call before each iteration; returns 0
+                                 once enough iterations have been timed
+    mb_finish ()               : report, write or compare against the
+                                 baseline; returns the number of
+                                 regressions
+
+  The iteration count per batch is doubled until a batch takes at
+  least xcell.microbench.min_time seconds, and the median of
+  xcell.microbench.reps batches is reported. A cell/kernel already in
+  the baseline file reuses its recorded iteration count, so runs are
+  compared like for like; it is a regression if it is more than
+  xcell.microbench.tol percent slower.
+*/
+int mb_init ();
+void mb_begin (const char *cell, const char *kernel, int ninputs);
+int mb_iter ();
+int mb_finish ();
+
+#endif /* __XCELL_MICROBENCH_H__ */
@@ -0,0 +1,292 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2021 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <common/config.h>
+#include <common/misc.h>
+#include "prof.h"
+#include "progress.h"
+#include "jobs.h"
+
+#define PROF_MAXDEPTH 16
+
+struct prof_usage {
+  double wall;			/* s */
+  double cpu;			/* s, this process */
+  double child_cpu;		/* s, waited-for children */
+};
+
+struct prof_phase {
+  char *cell;
+  char *phase;			/* parent/child/... */
+  double start;			/* s from prof_init */
+  struct prof_usage use;
+  long rss;			/* peak RSS so far, KB */
+  long child_rss;
+};
+
+struct prof_deck {
+  char *cell;
+  char *deck;
+  double tran;			/* ps */
+  int measures;
+  int arcs;
+};
+
+static int prof_on = 0;
+static double prof_t0;
+A_DECL (struct prof_phase, prof_rec);
+A_DECL (struct prof_deck, prof_decks);
+
+/*-- open phases --*/
+static int prof_depth = 0;
+static struct {
+  char *cell;
+  char *phase;
+  struct prof_usage at;
+} prof_stack[PROF_MAXDEPTH];
+
+static double tv_sec (struct timeval *tv)
+{
+  return tv->tv_sec + tv->tv_usec*1e-6;
+}
+
+static void prof_now (struct prof_usage *u)
+{
+  struct timespec ts;
+  struct rusage r;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  u->wall = ts.tv_sec + ts.tv_nsec*1e-9;
+  getrusage (RUSAGE_SELF, &r);
+  u->cpu = tv_sec (&r.ru_utime) + tv_sec (&r.ru_stime);
+  getrusage (RUSAGE_CHILDREN, &r);
+  u->child_cpu = tv_sec (&r.ru_utime) + tv_sec (&r.ru_stime);
+}
+
+void prof_init ()
+{
+  struct prof_usage u;
+
+  if (!config_exists ("xcell.profile")) {
+    return;
+  }
+  prof_on = 1;
+  prof_now (&u);
+  prof_t0 = u.wall;
+  A_INIT (prof_rec);
+  A_INIT (prof_decks);
+}
+
+void prof_begin (const char *cell, const char *phase)
+{
+  char *name;
+
+  if (!prof_on) return;
+  if (prof_depth == PROF_MAXDEPTH) {
+    fatal_error ("prof_begin: phases nested too deep");
+  }
+  if (!cell) {
+    cell = (prof_depth > 0 ? prof_stack[prof_depth-1].cell : "");
+  }
+  if (prof_depth > 0) {
+    const char *parent = prof_stack[prof_depth-1].phase;
+    MALLOC (name, char, strlen (parent) + strlen (phase) + 2);
+    sprintf (name, "%s/%s", parent, phase);
+  }
+  else {
+    name = Strdup (phase);
+  }
+  prof_stack[prof_depth].cell = Strdup (cell);
+  prof_stack[prof_depth].phase = name;
+  prof_now (&prof_stack[prof_depth].at);
+  prof_depth++;
+}
+
+void prof_end ()
+{
+  struct prof_usage u;
+  struct rusage r;
+
+  if (!prof_on) return;
+  Assert (prof_depth > 0, "prof_end without prof_begin");
+  prof_depth--;
+  prof_now (&u);
+
+  A_NEW (prof_rec, struct prof_phase);
+  A_NEXT (prof_rec).cell = prof_stack[prof_depth].cell;
+  A_NEXT (prof_rec).phase = prof_stack[prof_depth].phase;
+  A_NEXT (prof_rec).start = prof_stack[prof_depth].at.wall - prof_t0;
+  A_NEXT (prof_rec).use.wall = u.wall - prof_stack[prof_depth].at.wall;
+  A_NEXT (prof_rec).use.cpu = u.cpu - prof_stack[prof_depth].at.cpu;
+  A_NEXT (prof_rec).use.child_cpu =
+    u.child_cpu - prof_stack[prof_depth].at.child_cpu;
+  getrusage (RUSAGE_SELF, &r);
+  A_NEXT (prof_rec).rss = r.ru_maxrss;
+  getrusage (RUSAGE_CHILDREN, &r);
+  A_NEXT (prof_rec).child_rss = r.ru_maxrss;
+  A_INC (prof_rec);
+}
+
+int prof_system (const char *phase, const char *cmd, double limit)
+{
+  int ret;
+
+  prof_begin (NULL, phase);
+  if (limit > 0) {
+    struct job_pool *jp = jobs_new (1);
+    int id = jobs_submit_limit (jp, cmd, limit);
+    jobs_wait (jp);
+    ret = jobs_status (jp, id);
+    jobs_free (jp);
+  }
+  else {
+    progress_job_queued ();
+    progress_job_started ();
+    ret = system (cmd);
+    progress_job_done ();
+  }
+  prof_end ();
+  return ret;
+}
+
+void prof_deck (const char *spi, double tran, int narcs)
+{
+  char buf[1024];
+  FILE *fp;
+  int n = 0;
+
+  if (!prof_on) return;
+
+  fp = fopen (spi, "r");
+  if (fp) {
+    while (fgets (buf, 1024, fp)) {
+      if (strncasecmp (buf, ".measure", 8) == 0) {
+	n++;
+      }
+    }
+    fclose (fp);
+  }
+
+  A_NEW (prof_decks, struct prof_deck);
+  A_NEXT (prof_decks).cell =
+    Strdup (prof_depth > 0 ? prof_stack[prof_depth-1].cell : "");
+  A_NEXT (prof_decks).deck = Strdup (spi);
+  A_NEXT (prof_decks).tran = tran;
+  A_NEXT (prof_decks).measures = n;
+  A_NEXT (prof_decks).arcs = narcs;
+  A_INC (prof_decks);
+}
+
+static FILE *prof_open (const char *suffix)
+{
+  char buf[1024];
+  FILE *fp;
+
+  snprintf (buf, 1024, "%s.%s", config_get_string ("xcell.profile"), suffix);
+  fp = fopen (buf, "w");
+  if (!fp) {
+    warning ("Could not open profile output `%s'", buf);
+  }
+  return fp;
+}
+
+void prof_finish ()
+{
+  FILE *fp;
+
+  if (!prof_on) return;
+
+  while (prof_depth > 0) {
+    prof_end ();
+  }
+
+  /*-- summary: phases and decks --*/
+  if ((fp = prof_open ("json"))) {
+    fprintf (fp, "{\n  \"phases\": [\n");
+    for (int i=0; i < A_LEN (prof_rec); i++) {
+      struct prof_phase *p = &prof_rec[i];
+      fprintf (fp, "    { \"cell\": \"%s\", \"phase\": \"%s\", "
+	       "\"start\": %.6f, \"wall\": %.6f, \"cpu\": %.6f, "
+	       "\"child_cpu\": %.6f, \"rss_kb\": %ld, "
+	       "\"child_rss_kb\": %ld }%s\n",
+	       p->cell, p->phase, p->start, p->use.wall, p->use.cpu,
+	       p->use.child_cpu, p->rss, p->child_rss,
+	       i == A_LEN (prof_rec)-1 ? "" : ",");
+    }
+    fprintf (fp, "  ],\n  \"decks\": [\n");
+    for (int i=0; i < A_LEN (prof_decks); i++) {
+      struct prof_deck *d = &prof_decks[i];
+      fprintf (fp, "    { \"cell\": \"%s\", \"deck\": \"%s\", "
+	       "\"tran_ps\": %g, \"measures\": %d, \"arcs\": %d }%s\n",
+	       d->cell, d->deck, d->tran, d->measures, d->arcs,
+	       i == A_LEN (prof_decks)-1 ? "" : ",");
+    }
+    fprintf (fp, "  ]\n}\n");
+    fclose (fp);
+  }
+
+  if ((fp = prof_open ("csv"))) {
+    fprintf (fp, "cell,phase,start,wall,cpu,child_cpu,rss_kb,child_rss_kb\n");
+    for (int i=0; i < A_LEN (prof_rec); i++) {
+      struct prof_phase *p = &prof_rec[i];
+      fprintf (fp, "%s,%s,%.6f,%.6f,%.6f,%.6f,%ld,%ld\n",
+	       p->cell, p->phase, p->start, p->use.wall, p->use.cpu,
+	       p->use.child_cpu, p->rss, p->child_rss);
+    }
+    fclose (fp);
+  }
+
+  /*-- Chrome trace events (chrome://tracing, Perfetto): complete
+    events in microseconds --*/
+  if ((fp = prof_open ("trace.json"))) {
+    fprintf (fp, "{ \"traceEvents\": [\n");
+    for (int i=0; i < A_LEN (prof_rec); i++) {
+      struct prof_phase *p = &prof_rec[i];
+      const char *leaf = strrchr (p->phase, '/');
+      fprintf (fp, "  { \"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", "
+	       "\"ts\": %.0f, \"dur\": %.0f, \"pid\": 1, \"tid\": 1, "
+	       "\"args\": { \"cpu\": %.6f, \"child_cpu\": %.6f } }%s\n",
+	       leaf ? leaf + 1 : p->phase, p->cell, p->start*1e6,
+	       p->use.wall*1e6, p->use.cpu, p->use.child_cpu,
+	       i == A_LEN (prof_rec)-1 ? "" : ",");
+    }
+    fprintf (fp, "] }\n");
+    fclose (fp);
+  }
+
+  for (int i=0; i < A_LEN (prof_rec); i++) {
+    FREE (prof_rec[i].cell);
+    FREE (prof_rec[i].phase);
+  }
+  for (int i=0; i < A_LEN (prof_decks); i++) {
+    FREE (prof_decks[i].cell);
+    FREE (prof_decks[i].deck);
+  }
+  A_FREE (prof_rec);
+  A_FREE (prof_decks);
+  prof_on = 0;
+}
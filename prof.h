@@ -0,0 +1,54 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2021 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#ifndef __XCELL_PROF_H__
+#define __XCELL_PROF_H__
+
+/*
+  Per-phase profile of a characterization run, enabled by setting
+  xcell.profile to a file name prefix.
+
+    prof_init ()            : start profiling if xcell.profile is set
+    prof_begin (cell, ph)   : start phase ph; nested phases are named
+                              parent/child. cell NULL = same cell as
+                              the enclosing phase
+    prof_end ()             : end the innermost phase
+    prof_system (ph, cmd, limit) : system (cmd), timed as phase ph; a
+                              CPU limit (s) > 0 runs it under the
+                              watchdog, see jobs_submit_limit
+    prof_deck (spi, tran, narcs) : record a simulation deck: its
+                              transient length (ps) and number of
+                              arcs; .measure lines are counted from
+                              the file
+    prof_finish ()          : write <prefix>.json, <prefix>.csv and a
+                              Chrome trace-event file <prefix>.trace.json
+
+  Every phase records wall time, CPU time of xcell itself and of the
+  simulator (child) processes, and peak RSS of both.
+*/
+void prof_init ();
+void prof_begin (const char *cell, const char *phase);
+void prof_end ();
+int prof_system (const char *phase, const char *cmd, double limit = 0);
+void prof_deck (const char *spi, double tran, int narcs);
+void prof_finish ();
+
+#endif /* __XCELL_PROF_H__ */
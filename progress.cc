@@ -0,0 +1,228 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2021 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#include <stdio.h>
+#include <time.h>
+#include <common/config.h>
+#include <common/misc.h>
+#include "progress.h"
+
+static int ncells = 0;
+static double *cell_cost = NULL;
+static double *cell_time = NULL;	/* -1 if not done */
+static int cur_cell = -1;
+static const char *cur_name = "";
+static double cur_start;
+static double run_start;
+static double last_status = 0;
+
+static int jobs_queued = 0;
+static int jobs_running = 0;
+static int jobs_done = 0;
+
+static double now ()
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+/*
+  Simulation time grows with the circuit size times the simulated
+  time, which is roughly leakage vectors plus delay arcs over the
+  slew/load grid.
+*/
+double progress_cost (netlist_t *nl)
+{
+  int nin = 0, nout = 0, ntrans = 0;
+
+  if (!nl) {
+    return 0;
+  }
+  for (int i=0; i < A_LEN (nl->bN->ports); i++) {
+    if (nl->bN->ports[i].omit) continue;
+    if (nl->bN->ports[i].input) {
+      nin++;
+    }
+    else {
+      nout++;
+    }
+  }
+  /*-- every transistor is on the edge list of both its terminals --*/
+  for (node_t *n = nl->hd; n; n = n->next) {
+    for (listitem_t *li = list_first (n->e); li; li = list_next (li)) {
+      edge_t *e = (edge_t *) list_value (li);
+      if (e->a == n) {
+	ntrans++;
+      }
+    }
+  }
+  if (ntrans == 0) {
+    ntrans = 1;
+  }
+  if (nin > 24) {
+    nin = 24;
+  }
+  return (double)ntrans*((1 << nin) + 2.0*nin*nout*
+			 config_get_table_size ("xcell.input_trans")*
+			 config_get_table_size ("xcell.load"));
+}
+
+void progress_init (int n, double *cost)
+{
+  ncells = n;
+  MALLOC (cell_cost, double, n);
+  MALLOC (cell_time, double, n);
+  for (int i=0; i < n; i++) {
+    cell_cost[i] = cost[i];
+    cell_time[i] = -1;
+  }
+  run_start = now ();
+}
+
+/*-- least squares fit of time = a + b*cost over finished cells --*/
+static int fit (double *a, double *b)
+{
+  double sc = 0, st = 0, scc = 0, sct = 0;
+  int n = 0;
+
+  for (int i=0; i < ncells; i++) {
+    if (cell_time[i] < 0) continue;
+    sc += cell_cost[i];
+    st += cell_time[i];
+    scc += cell_cost[i]*cell_cost[i];
+    sct += cell_cost[i]*cell_time[i];
+    n++;
+  }
+  if (n == 0 || sc == 0) {
+    return 0;
+  }
+  *a = 0;
+  *b = st/sc;
+  if (n > 1 && n*scc - sc*sc > 0) {
+    double bb = (n*sct - sc*st)/(n*scc - sc*sc);
+    double aa = (st - bb*sc)/n;
+    if (bb > 0 && aa >= 0) {
+      *a = aa;
+      *b = bb;
+    }
+  }
+  return 1;
+}
+
+static void status (int force)
+{
+  double t = now ();
+  double a, b, eta = -1;
+  int done = 0;
+  char buf[1024];
+
+  if (!force && t - last_status < config_get_real ("xcell.status_interval")) {
+    return;
+  }
+  last_status = t;
+
+  for (int i=0; i < ncells; i++) {
+    if (cell_time[i] >= 0) done++;
+  }
+  if (fit (&a, &b)) {
+    eta = 0;
+    for (int i=0; i < ncells; i++) {
+      if (cell_time[i] >= 0) continue;
+      eta += a + b*cell_cost[i];
+      if (i == cur_cell) {
+	eta -= (t - cur_start);
+	if (eta < 0) eta = 0;
+      }
+    }
+  }
+
+  if (eta < 0) {
+    snprintf (buf, 1024, "ETA unknown");
+  }
+  else {
+    snprintf (buf, 1024, "ETA %dh%02dm%02ds", (int)(eta/3600),
+	      ((int)eta/60) % 60, (int)eta % 60);
+  }
+
+  if (force) {
+    printf ("[%d/%d cells] %d sims done, %.2f sims/s, %s\n", done, ncells,
+	    jobs_done, t > run_start ? jobs_done/(t - run_start) : 0.0, buf);
+    fflush (stdout);
+  }
+
+  if (config_exists ("xcell.status")) {
+    FILE *fp = fopen (config_get_string ("xcell.status"), "w");
+    if (fp) {
+      fprintf (fp, "cells_done %d\n", done);
+      fprintf (fp, "cells_total %d\n", ncells);
+      fprintf (fp, "cell %s\n", cur_cell >= 0 ? cur_name : "-");
+      fprintf (fp, "sims_queued %d\n", jobs_queued);
+      fprintf (fp, "sims_running %d\n", jobs_running);
+      fprintf (fp, "sims_done %d\n", jobs_done);
+      fprintf (fp, "elapsed %.0f\n", t - run_start);
+      fprintf (fp, "sims_per_sec %.3f\n",
+	       t > run_start ? jobs_done/(t - run_start) : 0.0);
+      fprintf (fp, "eta %.0f\n", eta);
+      fclose (fp);
+    }
+  }
+}
+
+void progress_cell_begin (int i, const char *name)
+{
+  if (i < 0 || i >= ncells) return;
+  cur_cell = i;
+  cur_name = name;
+  cur_start = now ();
+  status (0);
+}
+
+void progress_cell_end ()
+{
+  if (cur_cell < 0) return;
+  cell_time[cur_cell] = now () - cur_start;
+  cur_cell = -1;
+  status (1);
+}
+
+void progress_job_queued ()
+{
+  jobs_queued++;
+}
+
+void progress_job_started ()
+{
+  if (jobs_queued > 0) {
+    jobs_queued--;
+  }
+  jobs_running++;
+  status (0);
+}
+
+void progress_job_done ()
+{
+  if (jobs_running > 0) {
+    jobs_running--;
+  }
+  jobs_done++;
+  status (0);
+}
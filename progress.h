@@ -0,0 +1,50 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2021 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#ifndef __XCELL_PROGRESS_H__
+#define __XCELL_PROGRESS_H__
+
+#include <act/act.h>
+#include <act/passes.h>
+
+/*
+  Progress and ETA for a library run.
+
+    progress_cost (nl)           : relative cost of characterizing a cell
+    progress_init (n, cost)      : n cells with the given costs
+    progress_cell_begin (i, nm)  : start cell i
+    progress_cell_end ()         : finish the current cell; prints a
+                                   status line
+    progress_job_queued/started/done () : simulator runs
+
+  The ETA fits time = a + b*cost over the cells finished so far. The
+  status is also written to the file xcell.status (if set), at most
+  every xcell.status_interval seconds.
+*/
+double progress_cost (netlist_t *nl);
+void progress_init (int n, double *cost);
+void progress_cell_begin (int i, const char *name);
+void progress_cell_end ();
+void progress_job_queued ();
+void progress_job_started ();
+void progress_job_done ();
+
+#endif /* __XCELL_PROGRESS_H__ */
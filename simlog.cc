@@ -0,0 +1,223 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2021 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <common/config.h>
+#include <common/misc.h>
+#include "liberty.h"
+#include "simlog.h"
+
+struct simlog_stats {
+  char *name;			/* analysis */
+  int decks;
+  double accepted;		/* time steps */
+  double rejected;
+  double newton;		/* Newton iterations */
+  double setup;			/* s */
+  double total;			/* s */
+};
+
+A_DECL (struct simlog_stats, simlog);
+
+static void stats_add (struct simlog_stats *to, struct simlog_stats *s)
+{
+  to->decks += s->decks;
+  to->accepted += s->accepted;
+  to->rejected += s->rejected;
+  to->newton += s->newton;
+  to->setup += s->setup;
+  to->total += s->total;
+}
+
+/*-- value after the first ':' in buf --*/
+static double after_colon (const char *buf)
+{
+  const char *s = strchr (buf, ':');
+  return s ? atof (s+1) : 0;
+}
+
+/*
+  Xyce prints a summary per analysis (one per .step), with
+    Number Successful Steps Taken: / Number Failed Steps Attempted:
+    Number Linear Solves:
+  (one linear solve per Newton iteration; Jacobians can be reused
+  across iterations, so their count is not used) and the timing lines
+    ***** Problem read in and set up time: x seconds
+    ***** Total Elapsed Run Time: x seconds
+
+  hspice prints a job statistics summary:
+    transient  <time> <# points> <tot. iter> <conv. iter> rev= <n>
+    readin/errchk/setup <time>
+    total cpu time <time> seconds
+
+  Neither matches the other, so both are looked for.
+*/
+static void scan_log (FILE *fp, struct simlog_stats *st)
+{
+  char buf[1024];
+
+  while (fgets (buf, 1024, fp)) {
+    char *s = buf;
+    double t, pts, iter, conv;
+
+    while (isspace (*s)) s++;
+
+    if (strstr (buf, "Number Successful Steps Taken")) {
+      st->accepted += after_colon (buf);
+    }
+    else if (strstr (buf, "Number Failed Steps Attempted")) {
+      st->rejected += after_colon (buf);
+    }
+    else if (strstr (buf, "Number Linear Solves")) {
+      st->newton += after_colon (buf);
+    }
+    else if (strstr (buf, "Problem read in and set up time")) {
+      st->setup += after_colon (buf);
+    }
+    else if (strstr (buf, "Total Elapsed Run Time")) {
+      st->total += after_colon (buf);
+    }
+    else if (strncmp (s, "transient", 9) == 0) {
+      if (sscanf (s + 9, "%lf %lf %lf %lf", &t, &pts, &iter, &conv) == 4) {
+	st->accepted += pts;
+	st->newton += iter;
+      }
+      if ((s = strstr (s, "rev="))) {
+	st->rejected += atof (s + 4);
+      }
+    }
+    else if (strncmp (s, "readin", 6) == 0 ||
+	     strncmp (s, "errchk", 6) == 0 ||
+	     strncmp (s, "setup", 5) == 0) {
+      while (*s && !isspace (*s)) s++;
+      st->setup += atof (s);
+    }
+    else if (strncmp (s, "total cpu time", 14) == 0) {
+      st->total += atof (s + 14);
+    }
+  }
+}
+
+void simlog_scan (const char *file)
+{
+  char buf[1024];
+  struct simlog_stats st;
+  const char *s;
+  FILE *fp;
+  int i;
+
+  snprintf (buf, 1024, "%s.log", file);
+  fp = fopen (buf, "r");
+  if (!fp) {
+    return;
+  }
+  st.decks = 1;
+  st.accepted = 0;
+  st.rejected = 0;
+  st.newton = 0;
+  st.setup = 0;
+  st.total = 0;
+
+  scan_log (fp, &st);
+  fclose (fp);
+
+  /*-- abnormal decks --*/
+  if (st.accepted + st.rejected > 0 &&
+      st.rejected/(st.accepted + st.rejected) >
+      config_get_real ("xcell.simlog.max_reject")) {
+    warning ("%s: %.0f of %.0f time steps rejected", file, st.rejected,
+	     st.accepted + st.rejected);
+  }
+  if (st.total > config_get_real ("xcell.simlog.min_time") &&
+      st.setup > config_get_real ("xcell.simlog.max_setup")*st.total) {
+    warning ("%s: setup takes %.3gs of %.3gs", file, st.setup, st.total);
+  }
+
+  /*-- analysis name: the deck prefix without any batch number --*/
+  s = file;
+  if (*s == '_') s++;
+  i = 0;
+  buf[i++] = '_';
+  while (*s && *s != '_' && i < 1022) {
+    if (!isdigit (*s)) {
+      buf[i++] = *s;
+    }
+    s++;
+  }
+  buf[i++] = '_';
+  buf[i] = '\0';
+
+  for (i=0; i < A_LEN (simlog); i++) {
+    if (strcmp (simlog[i].name, buf) == 0) break;
+  }
+  if (i == A_LEN (simlog)) {
+    A_NEW (simlog, struct simlog_stats);
+    A_NEXT (simlog).name = Strdup (buf);
+    A_NEXT (simlog).decks = 0;
+    A_NEXT (simlog).accepted = 0;
+    A_NEXT (simlog).rejected = 0;
+    A_NEXT (simlog).newton = 0;
+    A_NEXT (simlog).setup = 0;
+    A_NEXT (simlog).total = 0;
+    A_INC (simlog);
+  }
+  stats_add (&simlog[i], &st);
+}
+
+static void print_stats (const char *name, struct simlog_stats *st)
+{
+  printf ("  %s: %d decks, %.0f steps (%.1f%% rejected), %.0f Newton, "
+	  "setup %.3gs of %.3gs\n", name, st->decks, st->accepted,
+	  st->accepted + st->rejected > 0 ?
+	  100*st->rejected/(st->accepted + st->rejected) : 0.0,
+	  st->newton, st->setup, st->total);
+}
+
+void simlog_report (const char *cell)
+{
+  struct simlog_stats all;
+
+  if (A_LEN (simlog) == 0) {
+    return;
+  }
+  all.decks = 0;
+  all.accepted = 0;
+  all.rejected = 0;
+  all.newton = 0;
+  all.setup = 0;
+  all.total = 0;
+  for (int i=0; i < A_LEN (simlog); i++) {
+    stats_add (&all, &simlog[i]);
+  }
+  print_stats (cell, &all);
+
+  for (int i=0; i < A_LEN (simlog); i++) {
+    if (verbose) {
+      print_stats (simlog[i].name, &simlog[i]);
+    }
+    FREE (simlog[i].name);
+  }
+  A_FREE (simlog);
+  A_INIT (simlog);
+}
@@ -0,0 +1,39 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2021 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#ifndef __XCELL_SIMLOG_H__
+#define __XCELL_SIMLOG_H__
+
+/*
+  Solver statistics scraped from simulator logs.
+
+    simlog_scan (file)    : read <file>.log (before it is deleted), add
+                            its statistics to the current cell, and
+                            warn if the deck looks abnormal
+    simlog_report (cell)  : print the statistics of the current cell
+                            (per analysis with verbose), and reset them
+
+  The analysis is named after the deck prefix, e.g. _spdy_ or _spmc_.
+*/
+void simlog_scan (const char *file);
+void simlog_report (const char *cell);
+
+#endif /* __XCELL_SIMLOG_H__ */
@@ -0,0 +1,84 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2021 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#include <stdio.h>
+#include <string.h>
+#include <common/config.h>
+#include <common/misc.h>
+#include "watchdog.h"
+
+struct wd_event {
+  char *deck;
+  double limit;
+  char *action;
+};
+
+A_DECL (struct wd_event, wd_events);
+
+double wd_limit (const char *spi, double tran, int nrows)
+{
+  char buf[1024];
+  FILE *fp;
+  int n = 0;
+
+  if (!config_get_int ("xcell.watchdog.enable")) {
+    return 0;
+  }
+
+  fp = fopen (spi, "r");
+  if (fp) {
+    while (fgets (buf, 1024, fp)) {
+      if (strncasecmp (buf, ".measure", 8) == 0) {
+	n++;
+      }
+    }
+    fclose (fp);
+  }
+  return config_get_real ("xcell.watchdog.base") +
+    config_get_real ("xcell.watchdog.per_ns")*nrows*tran*1e-3 +
+    config_get_real ("xcell.watchdog.per_measure")*n;
+}
+
+void wd_timeout (const char *spi, double limit, const char *action)
+{
+  warning ("%s: simulation killed after %.0fs of CPU time; %s", spi, limit,
+	   action);
+  A_NEW (wd_events, struct wd_event);
+  A_NEXT (wd_events).deck = Strdup (spi);
+  A_NEXT (wd_events).limit = limit;
+  A_NEXT (wd_events).action = Strdup (action);
+  A_INC (wd_events);
+}
+
+void wd_report ()
+{
+  if (A_LEN (wd_events) == 0) {
+    return;
+  }
+  printf ("\n%d simulations hit the watchdog limit:\n", A_LEN (wd_events));
+  for (int i=0; i < A_LEN (wd_events); i++) {
+    printf ("  %s (%.0fs): %s\n", wd_events[i].deck, wd_events[i].limit,
+	    wd_events[i].action);
+    FREE (wd_events[i].deck);
+    FREE (wd_events[i].action);
+  }
+  A_FREE (wd_events);
+}
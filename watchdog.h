@@ -0,0 +1,50 @@
+/*************************************************************************
+ *
+ *  Copyright (c) 2021 Rajit Manohar
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************
+ */
+#ifndef __XCELL_WATCHDOG_H__
+#define __XCELL_WATCHDOG_H__
+
+/*
+  Simulation watchdog. Every deck gets a CPU time limit, in seconds,
+  that grows with its total transient length (a deck sweeping nrows
+  loads or samples simulates its transient nrows times) and its
+  number of .measure lines:
+
+     xcell.watchdog.base + xcell.watchdog.per_ns * nrows * tran (ns)
+        + xcell.watchdog.per_measure * measures
+
+  A simulator that uses more CPU time than that, or runs for
+  xcell.watchdog.wall_factor times as long, is killed (see
+  jobs_submit_limit); the caller then decides what to try next.
+
+    wd_limit (spi, tran, nrows) : CPU limit for deck spi, with nrows
+                             transients of tran ps each (0 if
+                             xcell.watchdog.enable is not set)
+    wd_timeout (spi, limit, action) : record that deck spi was killed
+                             at the given limit, and what was done
+                             about it
+    wd_report ()           : print every timeout of the run
+*/
+double wd_limit (const char *spi, double tran, int nrows);
+void wd_timeout (const char *spi, double limit, const char *action);
+void wd_report ();
+
+#endif /* __XCELL_WATCHDOG_H__ */